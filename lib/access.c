@@ -22,23 +22,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 #include "access.h"
 #include "sensors.h"
 #include "data.h"
 #include "error.h"
+#include "init.h"
 #include "sysfs.h"
+#include "expr.h"
+#include "cache.h"
 
-/* We watch the recursion depth for variables only, as an easy way to
-   detect cycles. */
-#define DEPTH_MAX	8
-
-static int sensors_eval_expr(const sensors_chip_features *chip_features,
-			     const sensors_expr *expr,
-			     double val, int depth, double *result);
-
-/* Compare two chips name descriptions, to see whether they could match.
-   Return 0 if it does not match, return 1 if it does match. */
-static int sensors_match_chip(const sensors_chip_name *chip1,
+int sensors_match_chip(const sensors_chip_name *chip1,
 		       const sensors_chip_name *chip2)
 {
 	if ((chip1->prefix != SENSORS_CHIP_NAME_PREFIX_ANY) &&
@@ -64,6 +58,19 @@ static int sensors_match_chip(const sensors_chip_name *chip1,
 	return 1;
 }
 
+int sensors_chip_wanted(const sensors_ctx *ctx,
+			const sensors_chip_name *chip)
+{
+	int i;
+
+	if (!ctx->match)
+		return 1;
+	for (i = 0; i < ctx->match_count; i++)
+		if (sensors_match_chip(chip, &ctx->match[i]))
+			return 1;
+	return 0;
+}
+
 /* Returns, one by one, a pointer to all sensor_chip structs of the
    config file which match with the given chip name. Last should be
    the value returned by the last call, or NULL if this is the first
@@ -72,64 +79,151 @@ static int sensors_match_chip(const sensors_chip_name *chip1,
    Note that this visits the list of chips from last to first. Usually,
    you want the match that was latest in the config file. */
 static sensors_chip *
-sensors_for_all_config_chips(const sensors_chip_name *name,
+sensors_for_all_config_chips(const sensors_ctx *ctx,
+			     const sensors_chip_name *name,
 			     const sensors_chip *last)
 {
 	int nr, i;
 	sensors_chip_name_list chips;
 
-	for (nr = last ? last - sensors_config_chips - 1 :
-			 sensors_config_chips_count - 1; nr >= 0; nr--) {
+	for (nr = last ? last - ctx->config_chips - 1 :
+			 ctx->config_chips_count - 1; nr >= 0; nr--) {
 
-		chips = sensors_config_chips[nr].chips;
+		chips = ctx->config_chips[nr].chips;
 		for (i = 0; i < chips.fits_count; i++) {
 			if (sensors_match_chip(&chips.fits[i], name))
-				return sensors_config_chips + nr;
+				return ctx->config_chips + nr;
 		}
 	}
 	return NULL;
 }
 
-/* Look up a chip in the intern chip list, and return a pointer to it.
-   Do not modify the struct the return value points to! Returns NULL if
-   not found.*/
-static const sensors_chip_features *
-sensors_lookup_chip(const sensors_chip_name *name)
+/* Hash of a chip name (FNV-1a). The bus number is left out, because
+   sensors_parse_chip_name() sets it to SENSORS_BUS_NR_ANY for the bus
+   types which don't have one, and we want such names to use the index. */
+static unsigned int sensors_hash_chip_name(const sensors_chip_name *name)
 {
-	int i;
+	unsigned int h = 2166136261U;
+	const char *p;
 
-	for (i = 0; i < sensors_proc_chips_count; i++)
-		if (sensors_match_chip(&sensors_proc_chips[i].chip, name))
-			return &sensors_proc_chips[i];
+	for (p = name->prefix; *p; p++)
+		h = (h ^ (unsigned char)*p) * 16777619U;
+	h = (h ^ (unsigned short)name->bus.type) * 16777619U;
+	h = (h ^ (unsigned int)name->addr) * 16777619U;
 
-	return NULL;
+	return h;
 }
 
-/* Look up a subfeature of the given chip, and return a pointer to it.
-   Do not modify the struct the return value points to! Returns NULL if
-   not found.*/
-static const sensors_subfeature *
-sensors_lookup_subfeature_nr(const sensors_chip_features *chip,
-			     int subfeat_nr)
+void sensors_index_proc_chips(sensors_chip_list *list)
 {
-	if (subfeat_nr < 0 ||
-	    subfeat_nr >= chip->subfeature_count)
-		return NULL;
-	return chip->subfeature + subfeat_nr;
+	int i, size;
+	unsigned int h;
+
+	/* Keep the load factor at 50% at most. The index only grows, so
+	   that it is reused as chips come and go. */
+	for (size = 16; size < 2 * list->count; size *= 2)
+		;
+	if (size > list->index_size) {
+		free(list->index);
+		list->index = malloc(size * sizeof(int));
+		if (!list->index)
+			sensors_fatal_error(__func__, "Out of memory");
+		list->index_size = size;
+	}
+	size = list->index_size;
+	memset(list->index, 0, size * sizeof(int));
+
+	/* Chips are inserted in list order, so if several chips match a
+	   name, the first one is found first, as with a linear scan */
+	for (i = 0; i < list->count; i++) {
+		h = sensors_hash_chip_name(&list->chip[i]->chip);
+		for (h &= size - 1; list->index[h]; h = (h + 1) & (size - 1))
+			;
+		list->index[h] = i + 1;
+	}
 }
 
-/* Look up a feature of the given chip, and return a pointer to it.
-   Do not modify the struct the return value points to! Returns NULL if
-   not found.*/
-static const sensors_feature *
-sensors_lookup_feature_nr(const sensors_chip_features *chip, int feat_nr)
+sensors_chip_features *sensors_alloc_proc_chip(void)
 {
-	if (feat_nr < 0 ||
-	    feat_nr >= chip->feature_count)
-		return NULL;
-	return chip->feature + feat_nr;
+	sensors_chip_features *chip;
+
+	chip = calloc(1, sizeof(sensors_chip_features));
+	if (!chip)
+		sensors_fatal_error(__func__, "Out of memory");
+	sensors_arena_init(&chip->arena);
+	return chip;
+}
+
+void sensors_ref_handle(sensors_chip_handle *handle)
+{
+	__atomic_add_fetch(&handle->refs, 1, __ATOMIC_RELAXED);
+}
+
+void sensors_unref_handle(sensors_chip_handle *handle)
+{
+	if (!__atomic_sub_fetch(&handle->refs, 1, __ATOMIC_ACQ_REL))
+		free(handle);
+}
+
+/* No call can reach the chip any longer, so its handle is detached here
+   if it wasn't already */
+void sensors_free_proc_chip(sensors_chip_features *chip)
+{
+	if (chip->handle) {
+		__atomic_store_n(&chip->handle->chip, NULL, __ATOMIC_RELAXED);
+		sensors_unref_handle(chip->handle);
+	}
+	sensors_arena_free(&chip->arena);
+	pthread_mutex_destroy(&chip->arena.lock);
+	free(chip);
+}
+
+/* Find a chip in the intern chip list, loaded or not, and return a
+   pointer to it. Returns NULL if not found. */
+static sensors_chip_features *
+sensors_find_chip(const sensors_ctx *ctx, const sensors_chip_name *name)
+{
+	const sensors_chip_list *list = sensors_proc_chips(ctx);
+	const sensors_chip_name *chip;
+	sensors_chip_features *found = NULL;
+	unsigned int h, mask;
+	int i;
+
+	if (list->index &&
+	    name->prefix != SENSORS_CHIP_NAME_PREFIX_ANY &&
+	    name->bus.type != SENSORS_BUS_TYPE_ANY &&
+	    name->addr != SENSORS_CHIP_NAME_ADDR_ANY) {
+		mask = list->index_size - 1;
+		for (h = sensors_hash_chip_name(name) & mask;
+		     (i = list->index[h]); h = (h + 1) & mask) {
+			chip = &list->chip[i - 1]->chip;
+			/* Names returned by sensors_get_detected_chips()
+			   point to the chip itself, which disambiguates
+			   chips with the same name */
+			if (chip == name)
+				return list->chip[i - 1];
+			if (!found &&
+			    chip->bus.type == name->bus.type &&
+			    (chip->bus.nr == name->bus.nr ||
+			     name->bus.nr == SENSORS_BUS_NR_ANY) &&
+			    chip->addr == name->addr &&
+			    !strcmp(chip->prefix, name->prefix))
+				found = list->chip[i - 1];
+		}
+		return found;
+	}
+
+	/* Rare case of a pattern */
+	for (i = 0; i < list->count; i++)
+		if (sensors_match_chip(&list->chip[i]->chip, name))
+			return list->chip[i];
+
+	return NULL;
 }
 
+static sensors_chip_features *
+sensors_lookup_chip(sensors_ctx *ctx, const sensors_chip_name *name);
+
 /* Look up a subfeature by name, and return a pointer to it.
    Do not modify the struct the return value points to! Returns NULL if 
    not found.*/
@@ -159,362 +253,1456 @@ int sensors_chip_name_has_wildcards(const sensors_chip_name *chip)
 		return 0;
 }
 
+/* Find the label of each feature of a detected chip: the last label
+   statement which applies to it, or else its _label attribute. Features
+   without a label get their name. */
+static void sensors_resolve_labels(sensors_ctx *ctx,
+				   sensors_chip_features *chip_features)
+{
+	const sensors_chip *chip;
+	const char **label;
+	int i, j;
+
+	label = sensors_arena_alloc(&chip_features->arena,
+				    chip_features->feature_count *
+				    sizeof(*label));
+
+	for (chip = NULL;
+	     (chip = sensors_for_all_config_chips(ctx, &chip_features->chip,
+						   chip));)
+		for (i = 0; i < chip->labels_count; i++)
+			for (j = 0; j < chip_features->feature_count; j++)
+				if (!label[j] &&
+				    !strcmp(chip_features->feature[j].name,
+					    chip->labels[i].name))
+					label[j] = chip->labels[i].value;
+
+	sensors_read_sysfs_labels(&chip_features->arena, chip_features, label);
+
+	for (i = 0; i < chip_features->feature_count; i++)
+		if (!label[i])
+			label[i] = chip_features->feature[i].name;
+
+	chip_features->label = label;
+}
+
+static const char *sensors_get_label_ref_pinned(sensors_ctx *ctx,
+						const sensors_chip_name *name,
+						const sensors_feature *feature)
+{
+	sensors_chip_features *chip_features;
+	const char *label;
+
+	if (sensors_chip_name_has_wildcards(name))
+		return NULL;
+	if (!(chip_features = sensors_lookup_chip(ctx, name)) ||
+	    feature->number < 0 ||
+	    feature->number >= chip_features->feature_count)
+		return NULL;
+
+	pthread_mutex_lock(&ctx->label_lock);
+	if (!chip_features->label)
+		sensors_resolve_labels(ctx, chip_features);
+	label = chip_features->label[feature->number];
+	pthread_mutex_unlock(&ctx->label_lock);
+
+	return label;
+}
+
 /* Look up the label for a given feature. Note that chip should not
    contain wildcard values! The returned string is newly allocated (free it
    yourself). On failure, NULL is returned.
    If no label exists for this feature, its name is returned itself. */
-char *sensors_get_label(const sensors_chip_name *name,
-			const sensors_feature *feature)
+static char *sensors_get_label_pinned(sensors_ctx *ctx,
+				      const sensors_chip_name *name,
+				      const sensors_feature *feature)
 {
-	char *label;
-	const sensors_chip *chip;
-	char buf[PATH_MAX];
-	FILE *f;
-	int i;
+	const char *label;
+	char *res;
 
-	if (sensors_chip_name_has_wildcards(name))
+	if (!(label = sensors_get_label_ref_pinned(ctx, name, feature)))
 		return NULL;
 
-	for (chip = NULL; (chip = sensors_for_all_config_chips(name, chip));)
-		for (i = 0; i < chip->labels_count; i++)
-			if (!strcmp(feature->name, chip->labels[i].name)) {
-				label = chip->labels[i].value;
-				goto sensors_get_label_exit;
-			}
+	res = strdup(label);
+	if (!res)
+		sensors_fatal_error(__func__, "Allocating label text");
+	return res;
+}
 
-	/* No user specified label, check for a _label sysfs file */
-	snprintf(buf, PATH_MAX, "%s/%s_label", name->path, feature->name);
-	
-	if ((f = fopen(buf, "r"))) {
-		i = fread(buf, 1, sizeof(buf), f);
-		fclose(f);
-		if (i > 0) {
-			/* i - 1 to strip the '\n' at the end */
-			buf[i - 1] = 0;
-			label = buf;
-			goto sensors_get_label_exit;
-		}
-	}
+#define BITS_PER_LONG	(8 * sizeof(unsigned long))
 
-	/* No label, return the feature name instead */
-	label = feature->name;
-	
-sensors_get_label_exit:
-	label = strdup(label);
-	if (!label)
-		sensors_fatal_error(__func__, "Allocating label text");
-	return label;
+static int sensors_feature_ignored(const sensors_chip_features *chip_features,
+				   int nr)
+{
+	return chip_features->ignored &&
+	       (chip_features->ignored[nr / BITS_PER_LONG] >>
+		(nr % BITS_PER_LONG) & 1);
 }
 
-/* Looks up whether a feature should be ignored. Returns
-   1 if it should be ignored, 0 if not. */
-static int sensors_get_ignored(const sensors_chip_name *name,
-			       const sensors_feature *feature)
+/* Find out which features of a detected chip are ignored by the
+   configuration, and list the others */
+static void sensors_resolve_ignores(sensors_ctx *ctx,
+				    sensors_chip_features *chip_features)
 {
 	const sensors_chip *chip;
-	int i;
+	unsigned long *ignored = NULL;
+	int i, j;
 
-	for (chip = NULL; (chip = sensors_for_all_config_chips(name, chip));)
+	for (chip = NULL;
+	     (chip = sensors_for_all_config_chips(ctx, &chip_features->chip,
+						   chip));)
 		for (i = 0; i < chip->ignores_count; i++)
-			if (!strcmp(feature->name, chip->ignores[i].name))
-				return 1;
-	return 0;
+			for (j = 0; j < chip_features->feature_count; j++) {
+				if (strcmp(chip_features->feature[j].name,
+					   chip->ignores[i].name))
+					continue;
+				if (!ignored)
+					ignored = sensors_arena_alloc(
+						&chip_features->arena,
+						(chip_features->feature_count +
+						 BITS_PER_LONG - 1) /
+						BITS_PER_LONG *
+						sizeof(unsigned long));
+				ignored[j / BITS_PER_LONG] |=
+					1UL << (j % BITS_PER_LONG);
+				break;
+			}
+	chip_features->ignored = ignored;
+
+	chip_features->visible = sensors_arena_alloc(&chip_features->arena,
+			chip_features->feature_count *
+			sizeof(*chip_features->visible));
+	chip_features->visible_count = 0;
+	for (i = 0; i < chip_features->feature_count; i++)
+		if (!sensors_feature_ignored(chip_features, i))
+			chip_features->visible[chip_features->visible_count++] =
+				&chip_features->feature[i];
 }
 
-/* Read the value of a subfeature of a certain chip. Note that chip should not
-   contain wildcard values! This function will return 0 on success, and <0
-   on failure. */
-static int __sensors_get_value(const sensors_chip_name *name, int subfeat_nr,
-			       int depth, double *result)
+/* States of the features while looking for reference cycles */
+#define CHECK_NONE	0
+#define CHECK_BUSY	1
+#define CHECK_OK	2
+#define CHECK_CYCLE	3
+
+/* Look for reference cycles between the compute statements of a chip,
+   which would otherwise make reading values recurse endlessly. The
+   from_proc program of every feature in a cycle, or depending on one, is
+   replaced with one which fails. Chips are resolved when first read, from
+   any thread, so cycles are reported by sensors_report_compute_cycles()
+   instead. Returns 1 if feature nr is affected, 0 otherwise. */
+static int sensors_check_compute_cycles(sensors_chip_features *chip_features,
+					const sensors_compute **computes,
+					char *state, int nr)
 {
-	const sensors_chip_features *chip_features;
+	const sensors_prog *prog = chip_features->compute[nr].from_proc;
 	const sensors_subfeature *subfeature;
-	const sensors_expr *expr = NULL;
-	double val;
-	int res, i;
+	int i, cycle = 0;
+
+	state[nr] = CHECK_BUSY;
+	for (i = 0; i < prog->len; i++) {
+		if (prog->insn[i].op != sensors_op_var)
+			continue;
+		subfeature = &chip_features->subfeature[prog->insn[i].arg.nr];
+		if (!(subfeature->flags & SENSORS_COMPUTE_MAPPING) ||
+		    !computes[subfeature->mapping])
+			continue;
+
+		switch (state[subfeature->mapping]) {
+		case CHECK_NONE:
+			cycle |= sensors_check_compute_cycles(chip_features,
+					computes, state, subfeature->mapping);
+			break;
+		case CHECK_BUSY:
+		case CHECK_CYCLE:
+			cycle = 1;
+			break;
+		}
+	}
 
-	if (depth >= DEPTH_MAX)
-		return -SENSORS_ERR_RECURSION;
-	if (sensors_chip_name_has_wildcards(name))
-		return -SENSORS_ERR_WILDCARDS;
-	if (!(chip_features = sensors_lookup_chip(name)))
-		return -SENSORS_ERR_NO_ENTRY;
-	if (!(subfeature = sensors_lookup_subfeature_nr(chip_features,
-							subfeat_nr)))
-		return -SENSORS_ERR_NO_ENTRY;
-	if (!(subfeature->flags & SENSORS_MODE_R))
-		return -SENSORS_ERR_ACCESS_R;
+	if (cycle)
+		chip_features->compute[nr].from_proc =
+			sensors_fail_prog(-SENSORS_ERR_RECURSION,
+					  &chip_features->arena);
+	state[nr] = cycle ? CHECK_CYCLE : CHECK_OK;
+	return cycle;
+}
 
-	/* Apply compute statement if it exists */
-	if (subfeature->flags & SENSORS_COMPUTE_MAPPING) {
-		const sensors_feature *feature;
-		const sensors_chip *chip;
+/* Check whether expression expr references a subfeature of feature name.
+   Returns 1 if it does, 0 otherwise. */
+static int sensors_expr_uses_feature(const sensors_expr *expr,
+				     const char *name)
+{
+	size_t len;
+
+	switch (expr->kind) {
+	case sensors_kind_var:
+		len = strlen(name);
+		return !strncmp(expr->data.var, name, len) &&
+		       expr->data.var[len] == '_';
+	case sensors_kind_sub:
+		return sensors_expr_uses_feature(expr->data.subexpr.sub1, name) ||
+		       (expr->data.subexpr.sub2 &&
+			sensors_expr_uses_feature(expr->data.subexpr.sub2,
+						  name));
+	default:
+		return 0;
+	}
+}
+
+/* Report the reference cycles between the compute statements of a
+   configuration block, going from statement nr. This is done once, when
+   the configuration is loaded. Cycles spanning several blocks are only
+   found when a chip they apply to is resolved, and are not reported. */
+static void sensors_report_compute_cycles(const sensors_chip *chip,
+					  char *state, int nr)
+{
+	const sensors_compute *compute = &chip->computes[nr];
+	int i;
 
-		feature = sensors_lookup_feature_nr(chip_features,
-					subfeature->mapping);
+	state[nr] = CHECK_BUSY;
+	for (i = 0; i < chip->computes_count; i++) {
+		if (!sensors_expr_uses_feature(compute->from_proc,
+					       chip->computes[i].name))
+			continue;
+		if (state[i] == CHECK_NONE)
+			sensors_report_compute_cycles(chip, state, i);
+		else if (state[i] == CHECK_BUSY)
+			sensors_parse_error_wfn("Circular dependency in compute statement",
+						compute->line.filename,
+						compute->line.lineno);
+	}
+	state[nr] = CHECK_OK;
+}
 
-		chip = NULL;
-		while (!expr &&
-		       (chip = sensors_for_all_config_chips(name, chip)))
-			for (i = 0; i < chip->computes_count; i++) {
+/* Find the compute statements which apply to each feature of a detected
+   chip, and compile them. The configuration blocks are searched from last
+   to first, as sensors_for_all_config_chips() does. */
+static void sensors_resolve_computes(sensors_ctx *ctx,
+				     sensors_chip_features *chip_features)
+{
+	const sensors_chip **chips = NULL, *chip;
+	const sensors_compute **computes;
+	const sensors_feature *feature;
+	int chips_count = 0, chips_max = 0;
+	int i, j, k, found = 0;
+	char *state;
+
+	chip_features->compute = NULL;
+	chip_features->compute_vars = 0;
+	if (!chip_features->feature_count)
+		return;
+
+	/* Most configuration blocks don't apply to a given chip, so only
+	   match them once */
+	for (chip = NULL;
+	     (chip = sensors_for_all_config_chips(ctx, &chip_features->chip,
+						   chip));)
+		if (chip->computes_count)
+			sensors_add_array_el(&chip, &chips, &chips_count,
+					     &chips_max, sizeof(chip));
+	if (!chips_count)
+		return;
+
+	computes = calloc(chip_features->feature_count, sizeof(*computes));
+	if (!computes)
+		sensors_fatal_error(__func__, "Out of memory");
+	for (i = 0; i < chip_features->feature_count; i++) {
+		feature = &chip_features->feature[i];
+		for (j = 0; j < chips_count; j++) {
+			for (k = 0; k < chips[j]->computes_count; k++)
 				if (!strcmp(feature->name,
-					    chip->computes[i].name)) {
-					expr = chip->computes[i].from_proc;
+					    chips[j]->computes[k].name))
 					break;
-				}
+			if (k < chips[j]->computes_count) {
+				computes[i] = &chips[j]->computes[k];
+				found = 1;
+				break;
 			}
+		}
+	}
+	free(chips);
+
+	if (!found)
+		goto exit_free;
+
+	chip_features->compute = sensors_arena_alloc(&chip_features->arena,
+			chip_features->feature_count *
+			sizeof(sensors_feature_compute));
+	for (i = 0; i < chip_features->feature_count; i++) {
+		if (!computes[i])
+			continue;
+		chip_features->compute[i].from_proc =
+			sensors_compile_expr(chip_features,
+					     computes[i]->from_proc,
+					     &chip_features->arena);
+		chip_features->compute[i].to_proc =
+			sensors_compile_expr(chip_features,
+					     computes[i]->to_proc,
+					     &chip_features->arena);
+		if (chip_features->compute[i].from_proc->vars ||
+		    chip_features->compute[i].to_proc->vars)
+			chip_features->compute_vars = 1;
 	}
 
-	res = sensors_read_sysfs_attr(name, subfeature, &val);
-	if (res)
-		return res;
-	if (!expr)
-		*result = val;
-	else if ((res = sensors_eval_expr(chip_features, expr, val, depth,
-					  result)))
-		return res;
-	return 0;
+	state = calloc(chip_features->feature_count, 1);
+	if (!state)
+		sensors_fatal_error(__func__, "Out of memory");
+	for (i = 0; i < chip_features->feature_count; i++)
+		if (computes[i] && state[i] == CHECK_NONE)
+			sensors_check_compute_cycles(chip_features, computes,
+						     state, i);
+	free(state);
+
+exit_free:
+	free(computes);
 }
 
-int sensors_get_value(const sensors_chip_name *name, int subfeat_nr,
-		      double *result)
+/* Return the compiled compute statement which applies to a subfeature, if
+   any, as resolved by sensors_resolve_config(). Returns the from_proc
+   program if to_proc is 0, the to_proc program otherwise, or NULL if there
+   is no compute statement. */
+static const sensors_prog *
+sensors_lookup_compute(const sensors_chip_features *chip_features,
+		       const sensors_subfeature *subfeature, int to_proc)
 {
-	return __sensors_get_value(name, subfeat_nr, 0, result);
+	const sensors_feature_compute *compute;
+
+	if (!(subfeature->flags & SENSORS_COMPUTE_MAPPING) ||
+	    !chip_features->compute)
+		return NULL;
+
+	compute = &chip_features->compute[subfeature->mapping];
+	return to_proc ? compute->to_proc : compute->from_proc;
 }
 
-/* Set the value of a subfeature of a certain chip. Note that chip should not
-   contain wildcard values! This function will return 0 on success, and <0
-   on failure. */
-int sensors_set_value(const sensors_chip_name *name, int subfeat_nr,
-		      double value)
+/* Set up the handles of a detected chip and of its subfeatures, once its
+   compute statements are resolved. They are allocated along with the chip
+   handle, which holds the reference of the chip. */
+static void sensors_resolve_handles(sensors_ctx *ctx,
+				    sensors_chip_features *chip_features)
 {
-	const sensors_chip_features *chip_features;
-	const sensors_subfeature *subfeature;
-	const sensors_expr *expr = NULL;
-	int i, res;
-	double to_write;
+	sensors_chip_handle *handle;
+	sensors_sf_handle *sf;
+	int i;
 
-	if (sensors_chip_name_has_wildcards(name))
-		return -SENSORS_ERR_WILDCARDS;
-	if (!(chip_features = sensors_lookup_chip(name)))
-		return -SENSORS_ERR_NO_ENTRY;
-	if (!(subfeature = sensors_lookup_subfeature_nr(chip_features,
-							subfeat_nr)))
-		return -SENSORS_ERR_NO_ENTRY;
-	if (!(subfeature->flags & SENSORS_MODE_W))
-		return -SENSORS_ERR_ACCESS_W;
+	chip_features->handle = NULL;
+	if (!chip_features->subfeature_count)
+		return;
+
+	handle = malloc(sizeof(*handle) + chip_features->subfeature_count *
+			sizeof(*handle->sf));
+	if (!handle)
+		sensors_fatal_error(__func__, "Out of memory");
+	handle->pins = ctx->pins;
+	__atomic_store_n(&handle->chip, chip_features, __ATOMIC_RELAXED);
+	handle->sf = (sensors_sf_handle *)(handle + 1);
+	handle->refs = 1;
+
+	for (i = 0; i < chip_features->subfeature_count; i++) {
+		sf = &handle->sf[i];
+		sf->chip = handle;
+		sf->subfeature = &chip_features->subfeature[i];
+		sf->from_proc = sensors_lookup_compute(chip_features,
+						       sf->subfeature, 0);
+		sf->to_proc = sensors_lookup_compute(chip_features,
+						     sf->subfeature, 1);
+		sf->scale = sensors_get_type_scaling(sf->subfeature->type);
+	}
 
-	/* Apply compute statement if it exists */
-	if (subfeature->flags & SENSORS_COMPUTE_MAPPING) {
-		const sensors_feature *feature;
-		const sensors_chip *chip;
+	chip_features->handle = handle;
+}
 
-		feature = sensors_lookup_feature_nr(chip_features,
-					subfeature->mapping);
+static void sensors_resolve_chip_config(sensors_ctx *ctx,
+					sensors_chip_features *chip_features)
+{
+	sensors_resolve_computes(ctx, chip_features);
+	sensors_resolve_ignores(ctx, chip_features);
+	sensors_resolve_handles(ctx, chip_features);
+	chip_features->label = NULL;
+}
 
-		chip = NULL;
-		while (!expr &&
-		       (chip = sensors_for_all_config_chips(name, chip)))
-			for (i = 0; i < chip->computes_count; i++) {
-				if (!strcmp(feature->name,
-					    chip->computes[i].name)) {
-					expr = chip->computes[i].to_proc;
-					break;
-				}
-			}
+/* Chips which aren't loaded yet are resolved when they are */
+void sensors_resolve_config(sensors_ctx *ctx)
+{
+	const sensors_chip_list *list = sensors_proc_chips(ctx);
+	const sensors_chip *chip;
+	char *state;
+	int i, j;
+
+	for (i = 0; i < ctx->config_chips_count; i++) {
+		chip = &ctx->config_chips[i];
+		if (!chip->computes_count)
+			continue;
+		state = calloc(chip->computes_count, 1);
+		if (!state)
+			sensors_fatal_error(__func__, "Out of memory");
+		for (j = 0; j < chip->computes_count; j++)
+			if (state[j] == CHECK_NONE)
+				sensors_report_compute_cycles(chip, state, j);
+		free(state);
 	}
 
-	to_write = value;
-	if (expr)
-		if ((res = sensors_eval_expr(chip_features, expr,
-					     value, 0, &to_write)))
-			return res;
-	return sensors_write_sysfs_attr(name, subfeature, to_write);
+	ctx->resolved = 1;
+	for (i = 0; i < list->count; i++)
+		if (list->chip[i]->loaded)
+			sensors_resolve_chip_config(ctx, list->chip[i]);
 }
 
-const sensors_chip_name *sensors_get_detected_chips(const sensors_chip_name
-						    *match, int *nr)
+/* Pairs with the release store in sensors_load_chip_list(), so that a
+   chip seen as loaded is seen complete */
+static int sensors_chip_loaded(const sensors_chip_features *chip_features)
 {
-	const sensors_chip_name *res;
-
-	while (*nr < sensors_proc_chips_count) {
-		res = &sensors_proc_chips[(*nr)++].chip;
-		if (!match || sensors_match_chip(res, match))
-			return res;
-	}
-	return NULL;
+	return __atomic_load_n(&chip_features->loaded, __ATOMIC_ACQUIRE);
 }
 
-const char *sensors_get_adapter_name(const sensors_bus_id *bus)
+/* Read count chips from sysfs. Called with load_lock held. */
+static void sensors_load_chip_list(sensors_ctx *ctx,
+				   sensors_chip_features **chips, int count)
 {
+	const sensors_chip_list *list;
 	int i;
 
-	/* bus types with a single instance */
-	switch (bus->type) {
-	case SENSORS_BUS_TYPE_ISA:
-		return "ISA adapter";
-	case SENSORS_BUS_TYPE_PCI:
-		return "PCI adapter";
-	/* SPI should not be here, but for now SPI adapters have no name
-	   so we don't have any custom string to return. */
-	case SENSORS_BUS_TYPE_SPI:
-		return "SPI adapter";
-	case SENSORS_BUS_TYPE_VIRTUAL:
-		return "Virtual device";
-	case SENSORS_BUS_TYPE_ACPI:
-		return "ACPI interface";
-	/* HID should probably not be there either, but I don't know if
-	   HID buses have a name nor where to find it. */
-	case SENSORS_BUS_TYPE_HID:
-		return "HID adapter";
-	case SENSORS_BUS_TYPE_MDIO:
-		return "MDIO adapter";
-	case SENSORS_BUS_TYPE_SCSI:
-		return "SCSI adapter";
+	sensors_read_sysfs_features(ctx, chips, count);
+	for (i = 0; i < count; i++) {
+		sensors_set_sysfs_cache_time(chips[i], ctx->cache_time);
+		if (ctx->resolved)
+			sensors_resolve_chip_config(ctx, chips[i]);
+		__atomic_store_n(&chips[i]->loaded, 1, __ATOMIC_RELEASE);
 	}
 
-	/* bus types with several instances */
-	for (i = 0; i < sensors_proc_bus_count; i++)
-		if (sensors_proc_bus[i].bus.type == bus->type &&
-		    sensors_proc_bus[i].bus.nr == bus->nr)
-			return sensors_proc_bus[i].adapter;
-	return NULL;
+	/* The cache is saved from the chips once they are all loaded, so
+	   that sensors_init() never has to load them for that. Hotplug
+	   drops the cache key when it changes the chips. */
+	if (ctx->cache_key) {
+		list = sensors_proc_chips(ctx);
+		for (i = 0; i < list->count; i++)
+			if (!list->chip[i]->loaded)
+				return;
+		sensors_write_cache(ctx);
+	}
 }
 
-const sensors_feature *
-sensors_get_features(const sensors_chip_name *name, int *nr)
+/* Chips removed by sensors_hotplug_process() are no longer loaded, as
+   their attributes may be gone */
+void sensors_load_chips(sensors_ctx *ctx, const sensors_chip_name *match)
 {
-	const sensors_chip_features *chip;
+	const sensors_chip_list *list = sensors_proc_chips(ctx);
+	sensors_chip_features **chips;
+	int i, count = 0;
+
+	/* Most of the time, there is nothing left to load */
+	for (i = 0; i < list->count; i++)
+		if (!sensors_chip_loaded(list->chip[i]) &&
+		    (!match || sensors_match_chip(&list->chip[i]->chip,
+						  match)))
+			break;
+	if (i == list->count)
+		return;
+
+	chips = malloc((list->count - i) * sizeof(*chips));
+	if (!chips)
+		sensors_fatal_error(__func__, "Out of memory");
+
+	pthread_mutex_lock(&ctx->load_lock);
+	for (; i < list->count; i++)
+		if (!list->chip[i]->loaded && !list->chip[i]->removed &&
+		    (!match || sensors_match_chip(&list->chip[i]->chip,
+						  match)))
+			chips[count++] = list->chip[i];
+	sensors_load_chip_list(ctx, chips, count);
+	pthread_mutex_unlock(&ctx->load_lock);
+
+	free(chips);
+}
 
-	if (!(chip = sensors_lookup_chip(name)))
-		return NULL;	/* No such chip */
+static void sensors_load_chip(sensors_ctx *ctx,
+			      sensors_chip_features *chip_features)
+{
+	if (sensors_chip_loaded(chip_features))
+		return;
 
-	while (*nr < chip->feature_count
-	    && sensors_get_ignored(name, &chip->feature[*nr]))
-		(*nr)++;
-	if (*nr >= chip->feature_count)
+	pthread_mutex_lock(&ctx->load_lock);
+	if (!chip_features->loaded && !chip_features->removed)
+		sensors_load_chip_list(ctx, &chip_features, 1);
+	pthread_mutex_unlock(&ctx->load_lock);
+}
+
+/* Look up a chip in the intern chip list, load it if needed, and return a
+   pointer to it. Do not modify the struct the return value points to!
+   Returns NULL if not found, or if the chip has no subfeatures. */
+static sensors_chip_features *
+sensors_lookup_chip(sensors_ctx *ctx, const sensors_chip_name *name)
+{
+	sensors_chip_features *chip_features;
+
+	if (!(chip_features = sensors_find_chip(ctx, name)))
 		return NULL;
-	return &chip->feature[(*nr)++];
+	sensors_load_chip(ctx, chip_features);
+	return chip_features->subfeature_count ? chip_features : NULL;
 }
 
-const sensors_subfeature *
-sensors_get_all_subfeatures(const sensors_chip_name *name,
-			const sensors_feature *feature, int *nr)
+/* Same as sensors_lookup_chip(), returning the handle of the chip */
+static const sensors_chip_handle *
+sensors_lookup_chip_handle(sensors_ctx *ctx, const sensors_chip_name *name)
 {
-	const sensors_chip_features *chip;
-	const sensors_subfeature *subfeature;
+	const sensors_chip_features *chip_features;
 
-	if (!(chip = sensors_lookup_chip(name)))
-		return NULL;	/* No such chip */
+	if (!(chip_features = sensors_lookup_chip(ctx, name)))
+		return NULL;
+	return chip_features->handle;
+}
 
-	/* Seek directly to the first subfeature */
-	if (*nr < feature->first_subfeature)
-		*nr = feature->first_subfeature;
+/* Get count cleared samples for a sampling pass, from stack if they fit,
+   so that sampling passes don't allocate memory */
+static sensors_sample *sensors_get_samples(sensors_snapshot *snapshot,
+					   int count)
+{
+	sensors_sample *samples;
 
-	if (*nr >= chip->subfeature_count)
-		return NULL;	/* end of list */
-	subfeature = &chip->subfeature[(*nr)++];
-	if (subfeature->mapping == feature->number)
-		return subfeature;
-	return NULL;	/* end of subfeature list */
+	if (count <= SENSORS_SNAPSHOT_SAMPLES) {
+		memset(snapshot->stack, 0, count * sizeof(sensors_sample));
+		return snapshot->stack;
+	}
+
+	samples = calloc(count, sizeof(sensors_sample));
+	if (!samples)
+		sensors_fatal_error(__func__, "Out of memory");
+	return samples;
 }
 
-const sensors_subfeature *
-sensors_get_subfeature(const sensors_chip_name *name,
-		       const sensors_feature *feature,
-		       sensors_subfeature_type type)
+static void sensors_put_samples(sensors_snapshot *snapshot,
+				sensors_sample *samples)
 {
-	const sensors_chip_features *chip;
-	int i;
+	if (samples != snapshot->stack)
+		free(samples);
+}
 
-	if (!(chip = sensors_lookup_chip(name)))
-		return NULL;	/* No such chip */
+/* Start a sampling pass over a chip. Samples are only kept if memo is
+   set, which is only worth it if compute statements reference
+   subfeatures. */
+static void sensors_begin_snapshot(sensors_snapshot *snapshot,
+				   const sensors_chip_features *chip_features,
+				   int memo)
+{
+	snapshot->chip = chip_features;
+	snapshot->sample = NULL;
+	if (memo && chip_features->subfeature_count)
+		snapshot->sample = sensors_get_samples(snapshot,
+					chip_features->subfeature_count);
+}
 
-	for (i = feature->first_subfeature; i < chip->subfeature_count &&
-	     chip->subfeature[i].mapping == feature->number; i++) {
-		if (chip->subfeature[i].type == type)
-			return &chip->subfeature[i];
+static void sensors_end_snapshot(sensors_snapshot *snapshot)
+{
+	if (snapshot->sample)
+		sensors_put_samples(snapshot, snapshot->sample);
+}
+
+/* Read the raw value of a subfeature, unless it was already read during
+   this sampling pass */
+static int sensors_read_sample(sensors_snapshot *snapshot,
+			       const sensors_subfeature *subfeature,
+			       double *value)
+{
+	sensors_sample *sample;
+
+	if (!snapshot->sample)
+		return sensors_read_sysfs_attr(snapshot->chip, subfeature,
+					       value);
+
+	sample = &snapshot->sample[subfeature - snapshot->chip->subfeature];
+	if (!sample->read) {
+		sample->res = sensors_read_sysfs_timed(snapshot->chip,
+						       subfeature, &sample->val,
+						       &sample->start,
+						       &sample->end);
+		if (!sample->res)
+			sample->val /= sensors_get_type_scaling(subfeature->type);
+		sample->read = 1;
 	}
-	return NULL;	/* No such subfeature */
+	*value = sample->val;
+	return sample->res;
 }
 
-/* Evaluate an expression */
-static int sensors_eval_expr(const sensors_chip_features *chip_features,
-			     const sensors_expr *expr,
-			     double val, int depth, double *result)
+/* Read the value of a subfeature which was already looked up, and apply
+   the compute statement prog to it, if not NULL. This function will return
+   0 on success, and <0 on failure. */
+static int sensors_read_subfeature(sensors_snapshot *snapshot,
+				   const sensors_subfeature *subfeature,
+				   const sensors_prog *prog, double *result)
 {
-	double res1, res2;
+	double val;
 	int res;
-	const sensors_subfeature *subfeature;
 
-	if (expr->kind == sensors_kind_val) {
-		*result = expr->data.val;
-		return 0;
-	}
-	if (expr->kind == sensors_kind_source) {
-		*result = val;
-		return 0;
-	}
-	if (expr->kind == sensors_kind_var) {
-		if (!(subfeature = sensors_lookup_subfeature_name(chip_features,
-							    expr->data.var)))
-			return -SENSORS_ERR_NO_ENTRY;
-		return __sensors_get_value(&chip_features->chip,
-					   subfeature->number, depth + 1,
-					   result);
-	}
-	if ((res = sensors_eval_expr(chip_features, expr->data.subexpr.sub1,
-				     val, depth, &res1)))
+	if (!(subfeature->flags & SENSORS_MODE_R))
+		return -SENSORS_ERR_ACCESS_R;
+
+	res = sensors_read_sample(snapshot, subfeature, &val);
+	if (res)
 		return res;
-	if (expr->data.subexpr.sub2 &&
-	    (res = sensors_eval_expr(chip_features, expr->data.subexpr.sub2,
-				     val, depth, &res2)))
+	if (!prog)
+		*result = val;
+	else if ((res = sensors_run_prog(snapshot, prog, val, result)))
 		return res;
-	switch (expr->data.subexpr.op) {
-	case sensors_add:
-		*result = res1 + res2;
-		return 0;
-	case sensors_sub:
-		*result = res1 - res2;
-		return 0;
-	case sensors_multiply:
-		*result = res1 * res2;
-		return 0;
-	case sensors_divide:
-		if (res2 == 0.0)
-			return -SENSORS_ERR_DIV_ZERO;
-		*result = res1 / res2;
-		return 0;
-	case sensors_negate:
-		*result = -res1;
-		return 0;
-	case sensors_exp:
-		*result = exp(res1);
-		return 0;
-	case sensors_log:
-		if (res1 < 0.0)
-			return -SENSORS_ERR_DIV_ZERO;
-		*result = log(res1);
-		return 0;
-	}
 	return 0;
 }
 
-/* Execute all set statements for this particular chip. The chip may not 
-   contain wildcards!  This function will return 0 on success, and <0 on 
-   failure. */
-static int sensors_do_this_chip_sets(const sensors_chip_name *name)
+int sensors_read_snapshot_value(sensors_snapshot *snapshot, int subfeat_nr,
+				double *result)
 {
-	const sensors_chip_features *chip_features;
-	sensors_chip *chip;
+	const sensors_subfeature *subfeature;
+
+	subfeature = &snapshot->chip->subfeature[subfeat_nr];
+	return sensors_read_subfeature(snapshot, subfeature,
+			sensors_lookup_compute(snapshot->chip, subfeature, 0),
+			result);
+}
+
+/* The caller gets a reference, see sensors_free_chip_handle() */
+static const sensors_chip_handle *
+sensors_get_chip_handle_pinned(sensors_ctx *ctx, const sensors_chip_name *name)
+{
+	sensors_chip_features *chip_features;
+
+	if (sensors_chip_name_has_wildcards(name) ||
+	    !(chip_features = sensors_lookup_chip(ctx, name)))
+		return NULL;
+	sensors_ref_handle(chip_features->handle);
+	return chip_features->handle;
+}
+
+/* The functions which take handles pin what they read, as the handles
+   may come from a generation of the default context which a concurrent
+   sensors_reload() is freeing, or their chip may be removed by a
+   concurrent sensors_hotplug_process() */
+
+const sensors_chip_name *
+sensors_handle_get_name(const sensors_chip_handle *chip)
+{
+	const sensors_chip_features *chip_features;
+	int pin;
+
+	pin = sensors_pin(chip->pins);
+	chip_features = sensors_handle_chip(chip);
+	sensors_unpin(chip->pins, pin);
+	return chip_features ? &chip_features->chip : NULL;
+}
+
+static const sensors_sf_handle *
+sensors_lookup_sf_handle(const sensors_chip_handle *chip, int subfeat_nr)
+{
+	const sensors_chip_features *chip_features = sensors_handle_chip(chip);
+
+	if (!chip_features || subfeat_nr < 0 ||
+	    subfeat_nr >= chip_features->subfeature_count)
+		return NULL;
+	return &chip->sf[subfeat_nr];
+}
+
+const sensors_sf_handle *
+sensors_get_sf_handle(const sensors_chip_handle *chip, int subfeat_nr)
+{
+	const sensors_sf_handle *res;
+	int pin;
+
+	pin = sensors_pin(chip->pins);
+	res = sensors_lookup_sf_handle(chip, subfeat_nr);
+	sensors_unpin(chip->pins, pin);
+	return res;
+}
+
+void sensors_free_chip_handle(const sensors_chip_handle *chip)
+{
+	sensors_unref_handle((sensors_chip_handle *)chip);
+}
+
+/* Apply the compute statement of a subfeature, if any, to the value just
+   read from it */
+static int sensors_compute_value(const sensors_chip_features *chip_features,
+				 const sensors_sf_handle *sf, double val,
+				 double *result)
+{
+	sensors_snapshot snapshot;
+	sensors_sample *sample;
+	int res;
+
+	if (!sf->from_proc) {
+		*result = val;
+		return 0;
+	}
+
+	/* Compute statements referencing subfeatures get a sampling pass,
+	   which starts with the value just read */
+	sensors_begin_snapshot(&snapshot, chip_features, sf->from_proc->vars);
+	if (snapshot.sample) {
+		sample = &snapshot.sample[sf->subfeature -
+					  chip_features->subfeature];
+		sample->read = 1;
+		sample->val = val;
+	}
+	res = sensors_run_prog(&snapshot, sf->from_proc, val, result);
+	sensors_end_snapshot(&snapshot);
+	return res;
+}
+
+/* Read the value of a subfeature through its handle. Everything was
+   resolved when the handle was set up, so this is only the read itself,
+   scaling and the compute statement if any. */
+static int sensors_sf_read_value(const sensors_sf_handle *sf, double *result)
+{
+	const sensors_chip_features *chip_features =
+		sensors_handle_chip(sf->chip);
+	double val;
+	int res;
+
+	if (!chip_features)
+		return -SENSORS_ERR_NO_ENTRY;
+	if (!(sf->subfeature->flags & SENSORS_MODE_R))
+		return -SENSORS_ERR_ACCESS_R;
+
+	res = sensors_read_sysfs_value(chip_features, sf->subfeature, &val);
+	if (res)
+		return res;
+	return sensors_compute_value(chip_features, sf, val / sf->scale,
+				     result);
+}
+
+static int sensors_sf_read_timed(const sensors_sf_handle *sf,
+				 sensors_timed_value *value)
+{
+	const sensors_chip_features *chip_features =
+		sensors_handle_chip(sf->chip);
+	double val;
+	int res;
+
+	if (!chip_features)
+		return -SENSORS_ERR_NO_ENTRY;
+	if (!(sf->subfeature->flags & SENSORS_MODE_R))
+		return -SENSORS_ERR_ACCESS_R;
+
+	res = sensors_read_sysfs_timed(chip_features, sf->subfeature, &val,
+				       &value->start, &value->end);
+	if (res)
+		return res;
+	return sensors_compute_value(chip_features, sf, val / sf->scale,
+				     &value->value);
+}
+
+/* Read the value of a subfeature within a sampling pass which keeps
+   samples, along with the times its attribute was read */
+static int sensors_read_timed_subfeature(sensors_snapshot *snapshot,
+					 const sensors_sf_handle *sf,
+					 sensors_timed_value *value)
+{
+	const sensors_sample *sample;
+	int res;
+
+	res = sensors_read_subfeature(snapshot, sf->subfeature, sf->from_proc,
+				      &value->value);
+	if (res)
+		return res;
+
+	sample = &snapshot->sample[sf->subfeature - snapshot->chip->subfeature];
+	value->start = sample->start;
+	value->end = sample->end;
+	return 0;
+}
+
+/* Read the value of a subfeature through its handle, as the kernel exports
+   it */
+static int sensors_sf_read_raw(const sensors_sf_handle *sf,
+			       sensors_raw_value *value)
+{
+	const sensors_chip_features *chip_features =
+		sensors_handle_chip(sf->chip);
+	int res;
+
+	if (!chip_features)
+		return -SENSORS_ERR_NO_ENTRY;
+	if (!(sf->subfeature->flags & SENSORS_MODE_R))
+		return -SENSORS_ERR_ACCESS_R;
+
+	res = sensors_read_sysfs_raw(chip_features, sf->subfeature,
+				     &value->value);
+	if (res)
+		return res;
+	value->scale = sf->scale;
+	return 0;
+}
+
+/* Set the value of a subfeature through its handle */
+static int sensors_sf_write_value(const sensors_sf_handle *sf, double value)
+{
+	const sensors_chip_features *chip_features =
+		sensors_handle_chip(sf->chip);
+	sensors_snapshot snapshot;
+	double to_write;
+	int res;
+
+	if (!chip_features)
+		return -SENSORS_ERR_NO_ENTRY;
+	if (!(sf->subfeature->flags & SENSORS_MODE_W))
+		return -SENSORS_ERR_ACCESS_W;
+
+	/* Apply compute statement if it exists */
+	to_write = value;
+	if (sf->to_proc) {
+		sensors_begin_snapshot(&snapshot, chip_features,
+				       sf->to_proc->vars);
+		res = sensors_run_prog(&snapshot, sf->to_proc, value,
+				       &to_write);
+		sensors_end_snapshot(&snapshot);
+		if (res)
+			return res;
+	}
+	return sensors_write_sysfs_attr(chip_features, sf->subfeature,
+					to_write);
+}
+
+int sensors_handle_get_value(const sensors_sf_handle *sf, double *result)
+{
+	int res, pin;
+
+	pin = sensors_pin(sf->chip->pins);
+	res = sensors_sf_read_value(sf, result);
+	sensors_unpin(sf->chip->pins, pin);
+	return res;
+}
+
+int sensors_handle_get_timed_value(const sensors_sf_handle *sf,
+				   sensors_timed_value *value)
+{
+	int res, pin;
+
+	pin = sensors_pin(sf->chip->pins);
+	res = sensors_sf_read_timed(sf, value);
+	sensors_unpin(sf->chip->pins, pin);
+	return res;
+}
+
+int sensors_handle_get_raw_value(const sensors_sf_handle *sf,
+				 sensors_raw_value *value)
+{
+	int res, pin;
+
+	pin = sensors_pin(sf->chip->pins);
+	res = sensors_sf_read_raw(sf, value);
+	sensors_unpin(sf->chip->pins, pin);
+	return res;
+}
+
+int sensors_handle_set_value(const sensors_sf_handle *sf, double value)
+{
+	int res, pin;
+
+	pin = sensors_pin(sf->chip->pins);
+	res = sensors_sf_write_value(sf, value);
+	sensors_unpin(sf->chip->pins, pin);
+	return res;
+}
+
+/* Read the value of a subfeature of a certain chip. Note that chip should not
+   contain wildcard values! This function will return 0 on success, and <0
+   on failure. */
+static int sensors_get_value_pinned(sensors_ctx *ctx,
+				    const sensors_chip_name *name,
+				    int subfeat_nr, double *result)
+{
+	const sensors_chip_handle *chip;
+	const sensors_sf_handle *sf;
+
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(chip = sensors_lookup_chip_handle(ctx, name)) ||
+	    !(sf = sensors_lookup_sf_handle(chip, subfeat_nr)))
+		return -SENSORS_ERR_NO_ENTRY;
+
+	return sensors_sf_read_value(sf, result);
+}
+
+/* Read the values of several subfeatures of a certain chip at once. Note
+   that chip should not contain wildcard values! The chip is looked up only
+   once for all subfeatures, and the values are read in a single sampling
+   pass. */
+static int sensors_get_values_pinned(sensors_ctx *ctx,
+				     const sensors_chip_name *name,
+				     const int *subfeat_nrs, int count,
+				     double *values, int *errors)
+{
+	const sensors_chip_features *chip_features;
+	const sensors_sf_handle *sf;
+	sensors_snapshot snapshot;
+	int i, res, err = 0;
+
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(chip_features = sensors_lookup_chip(ctx, name)))
+		return -SENSORS_ERR_NO_ENTRY;
+
+	sensors_begin_snapshot(&snapshot, chip_features,
+			       chip_features->compute_vars);
+
+	for (i = 0; i < count; i++) {
+		if (!(sf = sensors_lookup_sf_handle(chip_features->handle,
+						    subfeat_nrs[i])))
+			res = -SENSORS_ERR_NO_ENTRY;
+		else
+			res = sensors_read_subfeature(&snapshot, sf->subfeature,
+						      sf->from_proc,
+						      &values[i]);
+
+		if (errors)
+			errors[i] = res;
+		if (res && !err)
+			err = res;
+	}
+
+	sensors_end_snapshot(&snapshot);
+	return err;
+}
+
+static int sensors_get_raw_value_pinned(sensors_ctx *ctx,
+					const sensors_chip_name *name,
+					int subfeat_nr,
+					sensors_raw_value *value)
+{
+	const sensors_chip_handle *chip;
+	const sensors_sf_handle *sf;
+
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(chip = sensors_lookup_chip_handle(ctx, name)) ||
+	    !(sf = sensors_lookup_sf_handle(chip, subfeat_nr)))
+		return -SENSORS_ERR_NO_ENTRY;
+
+	return sensors_sf_read_raw(sf, value);
+}
+
+static int sensors_get_raw_values_pinned(sensors_ctx *ctx,
+					 const sensors_chip_name *name,
+					 const int *subfeat_nrs, int count,
+					 sensors_raw_value *values,
+					 int *errors)
+{
+	const sensors_chip_handle *chip;
+	const sensors_sf_handle *sf;
+	int i, res, err = 0;
+
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(chip = sensors_lookup_chip_handle(ctx, name)))
+		return -SENSORS_ERR_NO_ENTRY;
+
+	for (i = 0; i < count; i++) {
+		if (!(sf = sensors_lookup_sf_handle(chip, subfeat_nrs[i])))
+			res = -SENSORS_ERR_NO_ENTRY;
+		else
+			res = sensors_sf_read_raw(sf, &values[i]);
+
+		if (errors)
+			errors[i] = res;
+		if (res && !err)
+			err = res;
+	}
+
+	return err;
+}
+
+static int sensors_get_timed_value_pinned(sensors_ctx *ctx,
+					  const sensors_chip_name *name,
+					  int subfeat_nr,
+					  sensors_timed_value *value)
+{
+	const sensors_chip_handle *chip;
+	const sensors_sf_handle *sf;
+
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(chip = sensors_lookup_chip_handle(ctx, name)) ||
+	    !(sf = sensors_lookup_sf_handle(chip, subfeat_nr)))
+		return -SENSORS_ERR_NO_ENTRY;
+
+	return sensors_sf_read_timed(sf, value);
+}
+
+/* Same as sensors_get_values_pinned(). The sampling pass always keeps
+   samples, as they hold the times of the reads. */
+static int sensors_get_timed_values_pinned(sensors_ctx *ctx,
+					   const sensors_chip_name *name,
+					   const int *subfeat_nrs, int count,
+					   sensors_timed_value *values,
+					   int *errors)
+{
+	const sensors_chip_features *chip_features;
+	const sensors_sf_handle *sf;
+	sensors_snapshot snapshot;
+	int i, res, err = 0;
+
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(chip_features = sensors_lookup_chip(ctx, name)))
+		return -SENSORS_ERR_NO_ENTRY;
+
+	sensors_begin_snapshot(&snapshot, chip_features, 1);
+
+	for (i = 0; i < count; i++) {
+		if (!(sf = sensors_lookup_sf_handle(chip_features->handle,
+						    subfeat_nrs[i])))
+			res = -SENSORS_ERR_NO_ENTRY;
+		else
+			res = sensors_read_timed_subfeature(&snapshot, sf,
+							    &values[i]);
+
+		if (errors)
+			errors[i] = res;
+		if (res && !err)
+			err = res;
+	}
+
+	sensors_end_snapshot(&snapshot);
+	return err;
+}
+
+/* A sampling plan: the handles of a fixed list of subfeatures, looked up
+   once by sensors_create_plan() */
+struct sensors_plan_entry {
+	const sensors_sf_handle *sf;
+	/* offset of the chip samples, or -1 if samples aren't kept */
+	int sample;
+	int ref;	/* first entry of the chip, holds its handle */
+};
+
+struct sensors_plan {
+	sensors_pins *pins;	/* those of the context */
+	int count;
+	int sample_count;	/* samples needed per execution */
+	sensors_sample *samples;
+	struct sensors_plan_entry entry[];
+};
+
+/* Resolve a list of subfeatures into a sampling plan. Note that the chips
+   should not contain wildcard values! This function will return 0 on
+   success, and <0 on failure. */
+static int sensors_create_plan_pinned(sensors_ctx *ctx,
+				      const sensors_chip_name * const *names,
+				      const int *subfeat_nrs, int count,
+				      sensors_plan **plan)
+{
+	struct sensors_plan_entry *entry;
+	const sensors_chip_features *chip_features;
+	sensors_plan *p;
+	int i, j, err;
+
+	p = malloc(sizeof(sensors_plan) +
+		   count * sizeof(struct sensors_plan_entry));
+	if (!p)
+		sensors_fatal_error(__func__, "Out of memory");
+	p->pins = ctx->pins;
+	p->count = count;
+	p->sample_count = 0;
+	p->samples = NULL;
+
+	for (i = 0; i < count; i++) {
+		entry = &p->entry[i];
+
+		err = -SENSORS_ERR_WILDCARDS;
+		if (sensors_chip_name_has_wildcards(names[i]))
+			goto exit_free;
+		err = -SENSORS_ERR_NO_ENTRY;
+		if (!(chip_features = sensors_lookup_chip(ctx, names[i])) ||
+		    !(entry->sf = sensors_lookup_sf_handle(
+					chip_features->handle, subfeat_nrs[i])))
+			goto exit_free;
+		err = -SENSORS_ERR_ACCESS_R;
+		if (!(entry->sf->subfeature->flags & SENSORS_MODE_R))
+			goto exit_free;
+
+		/* The plan holds a reference to the handle of each chip */
+		for (j = 0; j < i; j++)
+			if (p->entry[j].sf->chip == entry->sf->chip)
+				break;
+		entry->ref = j == i;
+		if (entry->ref)
+			sensors_ref_handle(entry->sf->chip);
+
+		/* Chips with compute statements referencing subfeatures get
+		   samples, shared by all the entries of the chip */
+		entry->sample = -1;
+		if (!chip_features->compute_vars)
+			continue;
+		if (j < i) {
+			entry->sample = p->entry[j].sample;
+		} else {
+			entry->sample = p->sample_count;
+			p->sample_count += chip_features->subfeature_count;
+		}
+	}
+
+	/* Allocated once, so that executing the plan doesn't allocate */
+	if (p->sample_count) {
+		p->samples = malloc(p->sample_count * sizeof(sensors_sample));
+		if (!p->samples)
+			sensors_fatal_error(__func__, "Out of memory");
+	}
+
+	*plan = p;
+	return 0;
+
+exit_free:
+	p->count = i;
+	sensors_free_plan(p);
+	return err;
+}
+
+/* Read the value of sf to value, through snapshot unless it is NULL */
+typedef int (*sensors_plan_read)(sensors_snapshot *snapshot,
+				 const sensors_sf_handle *sf, void *value);
+
+/* Read all the values of a sampling plan, in order, in a single sampling
+   pass. values is an array of elements of size bytes, which read fills in.
+   If errors is not NULL, errors[i] is set to 0 if values[i] could be read,
+   and <0 otherwise. This function will return 0 if all values could be
+   read, and <0 on failure. */
+static int sensors_run_plan(const sensors_plan *plan, sensors_plan_read read,
+			    void *values, size_t size, int *errors)
+{
+	const struct sensors_plan_entry *entry;
+	sensors_snapshot snapshot;
+	int i, res, pin, err = 0;
+
+	pin = sensors_pin(plan->pins);
+
+	if (plan->sample_count)
+		memset(plan->samples, 0,
+		       plan->sample_count * sizeof(sensors_sample));
+
+	for (i = 0; i < plan->count; i++) {
+		entry = &plan->entry[i];
+
+		/* The samples of all the chips share the buffer of the plan */
+		if (entry->sample >= 0 &&
+		    (snapshot.chip = sensors_handle_chip(entry->sf->chip))) {
+			snapshot.sample = plan->samples + entry->sample;
+			res = read(&snapshot, entry->sf,
+				   (char *)values + i * size);
+		} else {
+			res = read(NULL, entry->sf, (char *)values + i * size);
+		}
+
+		if (errors)
+			errors[i] = res;
+		if (res && !err)
+			err = res;
+	}
+
+	sensors_unpin(plan->pins, pin);
+	return err;
+}
+static int sensors_plan_read_value(sensors_snapshot *snapshot,
+				   const sensors_sf_handle *sf, void *value)
+{
+	if (snapshot)
+		return sensors_read_subfeature(snapshot, sf->subfeature,
+					       sf->from_proc, value);
+	return sensors_sf_read_value(sf, value);
+}
+
+static int sensors_plan_read_timed(sensors_snapshot *snapshot,
+				   const sensors_sf_handle *sf, void *value)
+{
+	if (snapshot)
+		return sensors_read_timed_subfeature(snapshot, sf, value);
+	return sensors_sf_read_timed(sf, value);
+}
+
+int sensors_execute_plan(const sensors_plan *plan, double *values,
+			 int *errors)
+{
+	return sensors_run_plan(plan, sensors_plan_read_value, values,
+				sizeof(*values), errors);
+}
+
+int sensors_execute_plan_timed(const sensors_plan *plan,
+			       sensors_timed_value *values, int *errors)
+{
+	return sensors_run_plan(plan, sensors_plan_read_timed, values,
+				sizeof(*values), errors);
+}
+
+int sensors_execute_plan_raw(const sensors_plan *plan,
+			     sensors_raw_value *values, int *errors)
+{
+	int i, res, pin, err = 0;
+
+	pin = sensors_pin(plan->pins);
+	for (i = 0; i < plan->count; i++) {
+		res = sensors_sf_read_raw(plan->entry[i].sf, &values[i]);
+
+		if (errors)
+			errors[i] = res;
+		if (res && !err)
+			err = res;
+	}
+
+	sensors_unpin(plan->pins, pin);
+	return err;
+}
+
+void sensors_free_plan(sensors_plan *plan)
+{
+	int i;
+
+	for (i = 0; i < plan->count; i++)
+		if (plan->entry[i].ref)
+			sensors_unref_handle(plan->entry[i].sf->chip);
+	free(plan->samples);
+	free(plan);
+}
+
+/* Set the value of a subfeature of a certain chip. Note that chip should not
+   contain wildcard values! This function will return 0 on success, and <0
+   on failure. */
+static int sensors_set_value_pinned(sensors_ctx *ctx,
+				    const sensors_chip_name *name,
+				    int subfeat_nr, double value)
+{
+	const sensors_chip_handle *chip;
+	const sensors_sf_handle *sf;
+
+	if (sensors_chip_name_has_wildcards(name))
+		return -SENSORS_ERR_WILDCARDS;
+	if (!(chip = sensors_lookup_chip_handle(ctx, name)) ||
+	    !(sf = sensors_lookup_sf_handle(chip, subfeat_nr)))
+		return -SENSORS_ERR_NO_ENTRY;
+
+	return sensors_sf_write_value(sf, value);
+}
+
+static const sensors_chip_name *
+sensors_get_detected_chips_pinned(sensors_ctx *ctx,
+				  const sensors_chip_name *match, int *nr)
+{
+	const sensors_chip_list *list;
+	sensors_chip_features *chip_features;
+
+	/* Load all the chips the caller is going to iterate over at once */
+	if (*nr == 0)
+		sensors_load_chips(ctx, match);
+
+	list = sensors_proc_chips(ctx);
+	while (*nr < list->count) {
+		chip_features = list->chip[(*nr)++];
+		if (match && !sensors_match_chip(&chip_features->chip, match))
+			continue;
+		sensors_load_chip(ctx, chip_features);
+		if (chip_features->subfeature_count)	/* else discarded */
+			return &chip_features->chip;
+	}
+	return NULL;
+}
+
+const char *sensors_ctx_get_adapter_name(sensors_ctx *ctx,
+					 const sensors_bus_id *bus)
+{
+	int i;
+
+	/* bus types with a single instance */
+	switch (bus->type) {
+	case SENSORS_BUS_TYPE_ISA:
+		return "ISA adapter";
+	case SENSORS_BUS_TYPE_PCI:
+		return "PCI adapter";
+	/* SPI should not be here, but for now SPI adapters have no name
+	   so we don't have any custom string to return. */
+	case SENSORS_BUS_TYPE_SPI:
+		return "SPI adapter";
+	case SENSORS_BUS_TYPE_VIRTUAL:
+		return "Virtual device";
+	case SENSORS_BUS_TYPE_ACPI:
+		return "ACPI interface";
+	/* HID should probably not be there either, but I don't know if
+	   HID buses have a name nor where to find it. */
+	case SENSORS_BUS_TYPE_HID:
+		return "HID adapter";
+	case SENSORS_BUS_TYPE_MDIO:
+		return "MDIO adapter";
+	case SENSORS_BUS_TYPE_SCSI:
+		return "SCSI adapter";
+	}
+
+	/* bus types with several instances */
+	for (i = 0; i < ctx->proc_bus_count; i++)
+		if (ctx->proc_bus[i].bus.type == bus->type &&
+		    ctx->proc_bus[i].bus.nr == bus->nr)
+			return ctx->proc_bus[i].adapter;
+	return NULL;
+}
+
+static const sensors_feature *
+sensors_next_feature(const sensors_chip_handle *handle, int *nr)
+{
+	const sensors_chip_features *chip = sensors_handle_chip(handle);
+
+	if (!chip)
+		return NULL;	/* Chip removed */
+
+	while (*nr < chip->feature_count
+	    && sensors_feature_ignored(chip, *nr))
+		(*nr)++;
+	if (*nr >= chip->feature_count)
+		return NULL;
+	return &chip->feature[(*nr)++];
+}
+
+const sensors_feature *
+sensors_handle_get_features(const sensors_chip_handle *handle, int *nr)
+{
+	const sensors_feature *res;
+	int pin;
+
+	pin = sensors_pin(handle->pins);
+	res = sensors_next_feature(handle, nr);
+	sensors_unpin(handle->pins, pin);
+	return res;
+}
+
+static const sensors_feature *
+sensors_get_features_pinned(sensors_ctx *ctx, const sensors_chip_name *name,
+			    int *nr)
+{
+	const sensors_chip_handle *handle;
+
+	if (!(handle = sensors_lookup_chip_handle(ctx, name)))
+		return NULL;	/* No such chip */
+	return sensors_next_feature(handle, nr);
+}
+
+static const sensors_feature * const *
+sensors_get_feature_list_pinned(sensors_ctx *ctx,
+				const sensors_chip_name *name, int *count)
+{
+	const sensors_chip_features *chip;
+
+	if (!(chip = sensors_lookup_chip(ctx, name)))
+		return NULL;	/* No such chip */
+
+	*count = chip->visible_count;
+	return chip->visible;
+}
+
+static const sensors_subfeature *
+sensors_next_subfeature(const sensors_chip_handle *handle,
+			const sensors_feature *feature, int *nr)
+{
+	const sensors_chip_features *chip = sensors_handle_chip(handle);
+	const sensors_subfeature *subfeature;
+
+	if (!chip)
+		return NULL;	/* Chip removed */
+
+	/* Seek directly to the first subfeature */
+	if (*nr < feature->first_subfeature)
+		*nr = feature->first_subfeature;
+
+	if (*nr >= chip->subfeature_count)
+		return NULL;	/* end of list */
+	subfeature = &chip->subfeature[(*nr)++];
+	if (subfeature->mapping == feature->number)
+		return subfeature;
+	return NULL;	/* end of subfeature list */
+}
+
+const sensors_subfeature *
+sensors_handle_get_all_subfeatures(const sensors_chip_handle *handle,
+				   const sensors_feature *feature, int *nr)
+{
+	const sensors_subfeature *res;
+	int pin;
+
+	pin = sensors_pin(handle->pins);
+	res = sensors_next_subfeature(handle, feature, nr);
+	sensors_unpin(handle->pins, pin);
+	return res;
+}
+
+static const sensors_subfeature *
+sensors_get_all_subfeatures_pinned(sensors_ctx *ctx,
+				   const sensors_chip_name *name,
+				   const sensors_feature *feature, int *nr)
+{
+	const sensors_chip_handle *handle;
+
+	if (!(handle = sensors_lookup_chip_handle(ctx, name)))
+		return NULL;	/* No such chip */
+	return sensors_next_subfeature(handle, feature, nr);
+}
+
+static const sensors_subfeature *
+sensors_find_subfeature(const sensors_chip_handle *handle,
+			const sensors_feature *feature,
+			sensors_subfeature_type type)
+{
+	const sensors_chip_features *chip = sensors_handle_chip(handle);
+	int i;
+
+	if (!chip)
+		return NULL;	/* Chip removed */
+
+	for (i = feature->first_subfeature; i < chip->subfeature_count &&
+	     chip->subfeature[i].mapping == feature->number; i++) {
+		if (chip->subfeature[i].type == type)
+			return &chip->subfeature[i];
+	}
+	return NULL;	/* No such subfeature */
+}
+
+const sensors_subfeature *
+sensors_handle_get_subfeature(const sensors_chip_handle *handle,
+			      const sensors_feature *feature,
+			      sensors_subfeature_type type)
+{
+	const sensors_subfeature *res;
+	int pin;
+
+	pin = sensors_pin(handle->pins);
+	res = sensors_find_subfeature(handle, feature, type);
+	sensors_unpin(handle->pins, pin);
+	return res;
+}
+
+static const sensors_subfeature *
+sensors_get_subfeature_pinned(sensors_ctx *ctx, const sensors_chip_name *name,
+			      const sensors_feature *feature,
+			      sensors_subfeature_type type)
+{
+	const sensors_chip_handle *handle;
+
+	if (!(handle = sensors_lookup_chip_handle(ctx, name)))
+		return NULL;	/* No such chip */
+	return sensors_find_subfeature(handle, feature, type);
+}
+
+/* Execute all set statements for this particular chip. The chip may not 
+   contain wildcards!  This function will return 0 on success, and <0 on 
+   failure. */
+static int sensors_do_this_chip_sets(sensors_ctx *ctx,
+				     const sensors_chip_name *name)
+{
+	const sensors_chip_features *chip_features;
+	sensors_chip *chip;
+	sensors_arena arena = SENSORS_ARENA_INITIALIZER;
+	sensors_snapshot snapshot;
+	const sensors_prog *prog;
 	double value;
 	int i;
 	int err = 0, res;
 	const sensors_subfeature *subfeature;
 
-	chip_features = sensors_lookup_chip(name);	/* Can't fail */
+	/* Only fails if the chip was just removed */
+	if (!(chip_features = sensors_lookup_chip(ctx, name)))
+		return -SENSORS_ERR_NO_ENTRY;
 
-	for (chip = NULL; (chip = sensors_for_all_config_chips(name, chip));)
+	for (chip = NULL; (chip = sensors_for_all_config_chips(ctx, name, chip));)
 		for (i = 0; i < chip->sets_count; i++) {
 			subfeature = sensors_lookup_subfeature_name(chip_features,
 							chip->sets[i].name);
@@ -526,9 +1714,13 @@ static int sensors_do_this_chip_sets(const sensors_chip_name *name)
 				continue;
 			}
 
-			res = sensors_eval_expr(chip_features,
-						chip->sets[i].value, 0,
-						0, &value);
+			prog = sensors_compile_expr(chip_features,
+						    chip->sets[i].value,
+						    &arena);
+			sensors_begin_snapshot(&snapshot, chip_features,
+					       prog->vars);
+			res = sensors_run_prog(&snapshot, prog, 0, &value);
+			sensors_end_snapshot(&snapshot);
 			if (res) {
 				sensors_parse_error_wfn("Error parsing expression",
 						    chip->sets[i].line.filename,
@@ -536,8 +1728,9 @@ static int sensors_do_this_chip_sets(const sensors_chip_name *name)
 				err = res;
 				continue;
 			}
-			if ((res = sensors_set_value(name, subfeature->number,
-						     value))) {
+			if ((res = sensors_set_value_pinned(ctx, name,
+							    subfeature->number,
+							    value))) {
 				sensors_parse_error_wfn("Failed to set value",
 						chip->sets[i].line.filename,
 						chip->sets[i].line.lineno);
@@ -545,21 +1738,542 @@ static int sensors_do_this_chip_sets(const sensors_chip_name *name)
 				continue;
 			}
 		}
+	sensors_arena_free(&arena);
 	return err;
 }
 
 /* Execute all set statements for this particular chip. The chip may contain
    wildcards!  This function will return 0 on success, and <0 on failure. */
-int sensors_do_chip_sets(const sensors_chip_name *name)
+static int sensors_do_chip_sets_pinned(sensors_ctx *ctx,
+				       const sensors_chip_name *name)
 {
 	int nr, this_res;
 	const sensors_chip_name *found_name;
 	int res = 0;
 
-	for (nr = 0; (found_name = sensors_get_detected_chips(name, &nr));) {
-		this_res = sensors_do_this_chip_sets(found_name);
+	for (nr = 0;
+	     (found_name = sensors_get_detected_chips_pinned(ctx, name,
+							     &nr));) {
+		this_res = sensors_do_this_chip_sets(ctx, found_name);
 		if (this_res)
 			res = this_res;
 	}
 	return res;
 }
+
+static void sensors_set_cache_time_pinned(sensors_ctx *ctx, int ms)
+{
+	const sensors_chip_list *list = sensors_proc_chips(ctx);
+	int i;
+
+	/* Chips loaded later pick it up from ctx */
+	pthread_mutex_lock(&ctx->load_lock);
+	ctx->cache_time = ms > 0 ? ms : 0;
+	for (i = 0; i < list->count; i++)
+		if (list->chip[i]->loaded)
+			sensors_set_sysfs_cache_time(list->chip[i],
+						     ctx->cache_time);
+	pthread_mutex_unlock(&ctx->load_lock);
+}
+
+static void sensors_flush_values_pinned(sensors_ctx *ctx,
+					const sensors_chip_name *match)
+{
+	const sensors_chip_list *list = sensors_proc_chips(ctx);
+	int i;
+
+	for (i = 0; i < list->count; i++)
+		if (sensors_chip_loaded(list->chip[i]) &&
+		    (!match || sensors_match_chip(&list->chip[i]->chip,
+						  match)))
+			sensors_flush_sysfs_values(list->chip[i]);
+}
+
+/* The functions of the context API pin what they read for the duration
+   of each call, see sensors_pin() */
+
+const sensors_chip_handle *
+sensors_ctx_get_chip_handle(sensors_ctx *ctx, const sensors_chip_name *name)
+{
+	const sensors_chip_handle *res;
+	int pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_chip_handle_pinned(ctx, name);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const char *sensors_ctx_get_label_ref(sensors_ctx *ctx,
+				      const sensors_chip_name *name,
+				      const sensors_feature *feature)
+{
+	const char *res;
+	int pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_label_ref_pinned(ctx, name, feature);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+char *sensors_ctx_get_label(sensors_ctx *ctx, const sensors_chip_name *name,
+			    const sensors_feature *feature)
+{
+	char *res;
+	int pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_label_pinned(ctx, name, feature);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_ctx_get_value(sensors_ctx *ctx, const sensors_chip_name *name,
+			  int subfeat_nr, double *result)
+{
+	int res, pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_value_pinned(ctx, name, subfeat_nr, result);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_ctx_get_values(sensors_ctx *ctx, const sensors_chip_name *name,
+			   const int *subfeat_nrs, int count, double *values,
+			   int *errors)
+{
+	int res, pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_values_pinned(ctx, name, subfeat_nrs, count, values,
+					errors);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_ctx_get_raw_value(sensors_ctx *ctx, const sensors_chip_name *name,
+			      int subfeat_nr, sensors_raw_value *value)
+{
+	int res, pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_raw_value_pinned(ctx, name, subfeat_nr, value);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_ctx_get_raw_values(sensors_ctx *ctx, const sensors_chip_name *name,
+			       const int *subfeat_nrs, int count,
+			       sensors_raw_value *values, int *errors)
+{
+	int res, pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_raw_values_pinned(ctx, name, subfeat_nrs, count,
+					    values, errors);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_ctx_get_timed_value(sensors_ctx *ctx,
+				const sensors_chip_name *name, int subfeat_nr,
+				sensors_timed_value *value)
+{
+	int res, pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_timed_value_pinned(ctx, name, subfeat_nr, value);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_ctx_get_timed_values(sensors_ctx *ctx,
+				 const sensors_chip_name *name,
+				 const int *subfeat_nrs, int count,
+				 sensors_timed_value *values, int *errors)
+{
+	int res, pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_timed_values_pinned(ctx, name, subfeat_nrs, count,
+					      values, errors);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_ctx_create_plan(sensors_ctx *ctx,
+			    const sensors_chip_name * const *names,
+			    const int *subfeat_nrs, int count,
+			    sensors_plan **plan)
+{
+	int res, pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_create_plan_pinned(ctx, names, subfeat_nrs, count, plan);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_ctx_set_value(sensors_ctx *ctx, const sensors_chip_name *name,
+			  int subfeat_nr, double value)
+{
+	int res, pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_set_value_pinned(ctx, name, subfeat_nr, value);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const sensors_chip_name *
+sensors_ctx_get_detected_chips(sensors_ctx *ctx,
+			       const sensors_chip_name *match, int *nr)
+{
+	const sensors_chip_name *res;
+	int pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_detected_chips_pinned(ctx, match, nr);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const sensors_feature *
+sensors_ctx_get_features(sensors_ctx *ctx, const sensors_chip_name *name,
+			 int *nr)
+{
+	const sensors_feature *res;
+	int pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_features_pinned(ctx, name, nr);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const sensors_feature * const *
+sensors_ctx_get_feature_list(sensors_ctx *ctx, const sensors_chip_name *name,
+			     int *count)
+{
+	const sensors_feature * const *res;
+	int pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_feature_list_pinned(ctx, name, count);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const sensors_subfeature *
+sensors_ctx_get_all_subfeatures(sensors_ctx *ctx,
+				const sensors_chip_name *name,
+				const sensors_feature *feature, int *nr)
+{
+	const sensors_subfeature *res;
+	int pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_all_subfeatures_pinned(ctx, name, feature, nr);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const sensors_subfeature *
+sensors_ctx_get_subfeature(sensors_ctx *ctx, const sensors_chip_name *name,
+			   const sensors_feature *feature,
+			   sensors_subfeature_type type)
+{
+	const sensors_subfeature *res;
+	int pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_get_subfeature_pinned(ctx, name, feature, type);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_ctx_do_chip_sets(sensors_ctx *ctx, const sensors_chip_name *name)
+{
+	int res, pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_do_chip_sets_pinned(ctx, name);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+void sensors_ctx_set_cache_time(sensors_ctx *ctx, int ms)
+{
+	int pin;
+
+	pin = sensors_pin(ctx->pins);
+	sensors_set_cache_time_pinned(ctx, ms);
+	sensors_unpin(ctx->pins, pin);
+}
+
+void sensors_ctx_flush_values(sensors_ctx *ctx,
+			      const sensors_chip_name *match)
+{
+	int pin;
+
+	pin = sensors_pin(ctx->pins);
+	sensors_flush_values_pinned(ctx, match);
+	sensors_unpin(ctx->pins, pin);
+}
+
+/* The functions of the original API work on the current generation of the
+   default context, which is pinned for the duration of each call */
+
+const sensors_chip_handle *
+sensors_get_chip_handle(const sensors_chip_name *name)
+{
+	sensors_ctx *ctx;
+	const sensors_chip_handle *res;
+	int pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_chip_handle_pinned(ctx, name);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const char *sensors_get_label_ref(const sensors_chip_name *name,
+				  const sensors_feature *feature)
+{
+	sensors_ctx *ctx;
+	const char *res;
+	int pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_label_ref_pinned(ctx, name, feature);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+char *sensors_get_label(const sensors_chip_name *name,
+			const sensors_feature *feature)
+{
+	sensors_ctx *ctx;
+	char *res;
+	int pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_label_pinned(ctx, name, feature);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_get_value(const sensors_chip_name *name, int subfeat_nr,
+		      double *result)
+{
+	sensors_ctx *ctx;
+	int res, pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_value_pinned(ctx, name, subfeat_nr, result);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_get_values(const sensors_chip_name *name, const int *subfeat_nrs,
+		       int count, double *values, int *errors)
+{
+	sensors_ctx *ctx;
+	int res, pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_values_pinned(ctx, name, subfeat_nrs, count, values,
+					errors);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_get_raw_value(const sensors_chip_name *name, int subfeat_nr,
+			  sensors_raw_value *value)
+{
+	sensors_ctx *ctx;
+	int res, pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_raw_value_pinned(ctx, name, subfeat_nr, value);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_get_raw_values(const sensors_chip_name *name,
+			   const int *subfeat_nrs, int count,
+			   sensors_raw_value *values, int *errors)
+{
+	sensors_ctx *ctx;
+	int res, pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_raw_values_pinned(ctx, name, subfeat_nrs, count,
+					    values, errors);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_get_timed_value(const sensors_chip_name *name, int subfeat_nr,
+			    sensors_timed_value *value)
+{
+	sensors_ctx *ctx;
+	int res, pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_timed_value_pinned(ctx, name, subfeat_nr, value);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_get_timed_values(const sensors_chip_name *name,
+			     const int *subfeat_nrs, int count,
+			     sensors_timed_value *values, int *errors)
+{
+	sensors_ctx *ctx;
+	int res, pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_timed_values_pinned(ctx, name, subfeat_nrs, count,
+					      values, errors);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_create_plan(const sensors_chip_name * const *names,
+			const int *subfeat_nrs, int count,
+			sensors_plan **plan)
+{
+	sensors_ctx *ctx;
+	int res, pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_create_plan_pinned(ctx, names, subfeat_nrs, count, plan);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_set_value(const sensors_chip_name *name, int subfeat_nr,
+		      double value)
+{
+	sensors_ctx *ctx;
+	int res, pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_set_value_pinned(ctx, name, subfeat_nr, value);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const sensors_chip_name *sensors_get_detected_chips(const sensors_chip_name
+						    *match, int *nr)
+{
+	sensors_ctx *ctx;
+	const sensors_chip_name *res;
+	int pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_detected_chips_pinned(ctx, match, nr);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const char *sensors_get_adapter_name(const sensors_bus_id *bus)
+{
+	sensors_ctx *ctx;
+	const char *res;
+	int pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_ctx_get_adapter_name(ctx, bus);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const sensors_feature *
+sensors_get_features(const sensors_chip_name *name, int *nr)
+{
+	sensors_ctx *ctx;
+	const sensors_feature *res;
+	int pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_features_pinned(ctx, name, nr);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const sensors_feature * const *
+sensors_get_feature_list(const sensors_chip_name *name, int *count)
+{
+	sensors_ctx *ctx;
+	const sensors_feature * const *res;
+	int pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_feature_list_pinned(ctx, name, count);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const sensors_subfeature *
+sensors_get_all_subfeatures(const sensors_chip_name *name,
+			const sensors_feature *feature, int *nr)
+{
+	sensors_ctx *ctx;
+	const sensors_subfeature *res;
+	int pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_all_subfeatures_pinned(ctx, name, feature, nr);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+const sensors_subfeature *
+sensors_get_subfeature(const sensors_chip_name *name,
+		       const sensors_feature *feature,
+		       sensors_subfeature_type type)
+{
+	sensors_ctx *ctx;
+	const sensors_subfeature *res;
+	int pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_get_subfeature_pinned(ctx, name, feature, type);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_do_chip_sets(const sensors_chip_name *name)
+{
+	sensors_ctx *ctx;
+	int res, pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_do_chip_sets_pinned(ctx, name);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+void sensors_set_cache_time(int ms)
+{
+	sensors_ctx *ctx;
+	int pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	sensors_set_cache_time_pinned(ctx, ms);
+	sensors_unpin(ctx->pins, pin);
+}
+
+void sensors_flush_values(const sensors_chip_name *match)
+{
+	sensors_ctx *ctx;
+	int pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	sensors_flush_values_pinned(ctx, match);
+	sensors_unpin(ctx->pins, pin);
+}
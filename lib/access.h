@@ -30,4 +30,69 @@
    if there are wildcards. */
 int sensors_chip_name_has_wildcards(const sensors_chip_name *chip);
 
+/* Compare two chips name descriptions, to see whether they could match.
+   Return 0 if it does not match, return 1 if it does match. */
+int sensors_match_chip(const sensors_chip_name *chip1,
+		       const sensors_chip_name *chip2);
+
+/* Check whether a chip is one of those the application asked
+   sensors_init_ex() to detect. Returns 1 if it is, 0 if it isn't. */
+int sensors_chip_wanted(const sensors_ctx *ctx,
+			const sensors_chip_name *chip);
+
+/* Build the hash index used to look up detected chips by name. It must be
+   rebuilt whenever the chips of list change. */
+void sensors_index_proc_chips(sensors_chip_list *list);
+
+/* Allocate a detected chip, and initialize its arena */
+sensors_chip_features *sensors_alloc_proc_chip(void);
+
+/* Free a detected chip and all the memory of its arena. Its attribute
+   files must be closed already. */
+void sensors_free_proc_chip(sensors_chip_features *chip);
+
+/* Take or drop a reference to a chip handle. The handle is freed with the
+   last one. */
+void sensors_ref_handle(sensors_chip_handle *handle);
+void sensors_unref_handle(sensors_chip_handle *handle);
+
+/* Find out which configuration statements apply to each detected chip,
+   once the configuration is loaded, so that reading values doesn't
+   involve the configuration tables. Reference cycles between compute
+   statements are reported then. */
+void sensors_resolve_config(sensors_ctx *ctx);
+
+/* Read the features and subfeatures of the detected chips which match
+   (all of them if match is NULL) and aren't loaded yet. Chips are
+   otherwise loaded one at a time, when first needed. */
+void sensors_load_chips(sensors_ctx *ctx, const sensors_chip_name *match);
+
+/* A raw value read from the kernel */
+typedef struct sensors_sample {
+	int read;		/* 1 once the attribute was read */
+	int res;		/* 0 on success, <0 on failure */
+	double val;
+	long long start, end;	/* when it was read, see sensors_timed_value */
+} sensors_sample;
+
+/* Number of samples a sampling pass keeps on the stack. Only passes
+   needing more than that allocate them. */
+#define SENSORS_SNAPSHOT_SAMPLES	128
+
+/* The raw values of the subfeatures of a detected chip, as read during
+   one sampling pass. Each attribute is read from the kernel at most once
+   per pass, and all the values computed from it during the pass are based
+   on that sample. If sample is NULL, attributes are read every time. */
+typedef struct sensors_snapshot {
+	const sensors_chip_features *chip;
+	sensors_sample *sample;		/* one per subfeature */
+	sensors_sample stack[SENSORS_SNAPSHOT_SAMPLES];
+} sensors_snapshot;
+
+/* Read the value of subfeature subfeat_nr (an index into the subfeature
+   array) of the chip of snapshot, with its compute statement applied. This
+   function will return 0 on success, and <0 on failure. */
+int sensors_read_snapshot_value(sensors_snapshot *snapshot, int subfeat_nr,
+				double *result);
+
 #endif /* def LIB_SENSORS_ACCESS_H */
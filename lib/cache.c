@@ -0,0 +1,494 @@
+/*
+    cache.c - Part of libsensors, a Linux library for reading sensor data.
+    Copyright (C) 2026        The lm-sensors developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+/*
+ * Cache of the detected chips and i2c adapters
+ *
+ * Discovering the chips means reading and classifying every attribute of
+ * every hwmon device, which is by far the most expensive part of
+ * sensors_init(). So we save the result in RUNDIR, if that directory
+ * exists and we are allowed to write to it, and reuse it as long as the
+ * system didn't reboot and no hwmon device or i2c adapter was added,
+ * removed or recreated. Devices are identified by the inode number and
+ * modification time of their sysfs directory. The access rights of the
+ * attributes are checked again when each chip is first used.
+ *
+ * Integers are stored as int32_t, and the inode numbers and modification
+ * times of the key as 64-bit integers, whatever their size in struct stat.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <dirent.h>
+#include "data.h"
+#include "error.h"
+#include "access.h"
+#include "sysfs.h"
+#include "cache.h"
+#include "../version.h"
+
+#define CACHE_MAGIC	"lm-sensors chips cache " LM_VERSION
+#define BOOT_ID_FILE	"/proc/sys/kernel/random/boot_id"
+
+struct cache_buf {
+	char *data;
+	size_t len, max;
+};
+
+static void buf_put(struct cache_buf *b, const void *p, size_t len)
+{
+	if (b->len + len > b->max) {
+		b->max = (b->len + len) * 2 + 256;
+		b->data = realloc(b->data, b->max);
+		if (!b->data)
+			sensors_fatal_error(__func__, "Out of memory");
+	}
+	memcpy(b->data + b->len, p, len);
+	b->len += len;
+}
+
+static void buf_put_int(struct cache_buf *b, int val)
+{
+	int32_t v = val;
+
+	buf_put(b, &v, sizeof(v));
+}
+
+static void buf_put_int64(struct cache_buf *b, int64_t val)
+{
+	buf_put(b, &val, sizeof(val));
+}
+
+static void buf_put_str(struct cache_buf *b, const char *str)
+{
+	int len = strlen(str) + 1;
+
+	buf_put_int(b, len);
+	buf_put(b, str, len);
+}
+
+struct cache_reader {
+	const char *p, *end;
+	int err;
+	sensors_ctx *ctx;	/* context the chips are added to */
+};
+
+static void get(struct cache_reader *r, void *p, size_t len)
+{
+	if (r->err || (size_t)(r->end - r->p) < len) {
+		r->err = 1;
+		memset(p, 0, len);
+		return;
+	}
+	memcpy(p, r->p, len);
+	r->p += len;
+}
+
+static int get_int(struct cache_reader *r)
+{
+	int32_t val;
+
+	get(r, &val, sizeof(val));
+	return val;
+}
+
+/* Returns a pointer into the cache, not a copy */
+static const char *get_str_ptr(struct cache_reader *r)
+{
+	const char *str;
+	int len;
+
+	len = get_int(r);
+	if (r->err || len <= 0 || r->end - r->p < len ||
+	    r->p[len - 1] != '\0') {
+		r->err = 1;
+		return NULL;
+	}
+	str = r->p;
+	r->p += len;
+	return str;
+}
+
+static char *get_str(struct cache_reader *r)
+{
+	const char *str;
+	char *copy;
+
+	if (!(str = get_str_ptr(r)))
+		return NULL;
+	copy = strdup(str);
+	if (!copy)
+		sensors_fatal_error(__func__, "Out of memory");
+	return copy;
+}
+
+/* Same as get_str(), but the copy belongs to arena */
+static char *get_arena_str(struct cache_reader *r, sensors_arena *arena)
+{
+	const char *str;
+
+	if (!(str = get_str_ptr(r)))
+		return NULL;
+	return sensors_arena_strdup(arena, str);
+}
+
+/* Number of elements the remaining data could hold at most, to reject
+   insane counts before allocating memory for them */
+static int get_count(struct cache_reader *r, size_t el_size)
+{
+	int count;
+
+	count = get_int(r);
+	if (count < 0 || (size_t)count > (size_t)(r->end - r->p) / el_size)
+		r->err = 1;
+	return r->err ? 0 : count;
+}
+
+static int add_class_key(struct cache_buf *key, const char *class_name)
+{
+	char path[PATH_MAX];
+	DIR *dir;
+	struct dirent *ent;
+	struct stat st;
+
+	if (snprintf(path, sizeof(path), "%s/class/%s", sensors_sysfs_mount,
+		     class_name) >= (int)sizeof(path))
+		return -1;
+	if (!(dir = opendir(path)))
+		return errno == ENOENT ? 0 : -1;
+
+	buf_put_str(key, class_name);
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')	/* skip hidden entries */
+			continue;
+
+		if (fstatat(dirfd(dir), ent->d_name, &st, 0) < 0) {
+			closedir(dir);
+			return -1;
+		}
+		buf_put_str(key, ent->d_name);
+		buf_put_int64(key, st.st_ino);
+		buf_put_int64(key, st.st_mtim.tv_sec);
+		buf_put_int64(key, st.st_mtim.tv_nsec);
+	}
+	closedir(dir);
+	return 0;
+}
+
+/* Build the data which identifies the current set of devices. Returns 0
+   on success, -1 if the cache can't be used. */
+static int cache_key(struct cache_buf *key)
+{
+	char boot_id[64];
+	ssize_t len;
+	int fd;
+
+	if ((fd = open(BOOT_ID_FILE, O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+	len = read(fd, boot_id, sizeof(boot_id) - 1);
+	close(fd);
+	if (len <= 0)
+		return -1;
+	boot_id[len] = '\0';
+
+	buf_put_str(key, boot_id);
+	buf_put_str(key, sensors_sysfs_mount);
+	if (add_class_key(key, "hwmon") || add_class_key(key, "i2c-adapter"))
+		return -1;
+	return 0;
+}
+
+static void read_bus(struct cache_reader *r)
+{
+	sensors_ctx *ctx = r->ctx;
+	sensors_bus entry;
+	int i, count;
+
+	count = get_count(r, 2 * sizeof(int32_t));
+	for (i = 0; i < count && !r->err; i++) {
+		entry.bus.type = get_int(r);
+		entry.bus.nr = get_int(r);
+		if (!(entry.adapter = get_str(r)))
+			break;
+		sensors_add_proc_bus(ctx, &entry);
+	}
+}
+
+/* Check that a subfeature read from the cache is one we could have found:
+   its type must be the one of its name, and it must belong to a feature
+   of the matching type */
+static int valid_subfeature(const sensors_chip_features *chip,
+			    const sensors_subfeature *subfeature)
+{
+	int nr;
+
+	return subfeature->type != SENSORS_SUBFEATURE_UNKNOWN &&
+	       subfeature->type ==
+			sensors_subfeature_get_type(subfeature->name, &nr) &&
+	       (int)(subfeature->type >> 8) ==
+			(int)chip->feature[subfeature->mapping].type &&
+	       !(subfeature->flags & ~(SENSORS_MODE_R | SENSORS_MODE_W |
+				       SENSORS_COMPUTE_MAPPING));
+}
+
+static void read_chips(struct cache_reader *r)
+{
+	sensors_ctx *ctx = r->ctx;
+	sensors_chip_features *chip;
+	int i, j, count;
+
+	count = get_count(r, 7 * sizeof(int32_t));
+	for (i = 0; i < count && !r->err; i++) {
+		/* The chip is restored with its features, but it still gets
+		   loaded when first needed, to check the access rights of
+		   its attributes, which the cache key doesn't cover */
+		chip = sensors_alloc_proc_chip();
+		chip->chip.bus.type = get_int(r);
+		chip->chip.bus.nr = get_int(r);
+		chip->chip.addr = get_int(r);
+		chip->feature_count = get_count(r, 4 * sizeof(int32_t));
+		chip->subfeature_count = get_count(r, 5 * sizeof(int32_t));
+		if (r->err || !chip->feature_count ||
+		    !chip->subfeature_count) {
+			sensors_free_proc_chip(chip);
+			r->err = 1;
+			break;
+		}
+
+		/* Add the chip right away, so that it gets cleaned up if
+		   the rest of the cache is corrupted */
+		chip->feature = sensors_arena_alloc(&chip->arena,
+				chip->feature_count * sizeof(sensors_feature));
+		chip->subfeature = sensors_arena_alloc(&chip->arena,
+				chip->subfeature_count *
+				sizeof(sensors_subfeature));
+		sensors_add_proc_chips(sensors_proc_chips(ctx), &chip);
+
+		chip->chip.prefix = get_arena_str(r, &chip->arena);
+		chip->chip.path = get_arena_str(r, &chip->arena);
+
+		for (j = 0; j < chip->feature_count && !r->err; j++) {
+			sensors_feature *feature = &chip->feature[j];
+
+			feature->name = get_arena_str(r, &chip->arena);
+			feature->number = get_int(r);
+			feature->type = get_int(r);
+			feature->first_subfeature = get_int(r);
+			if (feature->number != j ||
+			    feature->first_subfeature < 0 ||
+			    feature->first_subfeature >= chip->subfeature_count)
+				r->err = 1;
+		}
+		for (j = 0; j < chip->subfeature_count && !r->err; j++) {
+			sensors_subfeature *subfeature = &chip->subfeature[j];
+
+			subfeature->name = get_arena_str(r, &chip->arena);
+			subfeature->number = get_int(r);
+			subfeature->type = get_int(r);
+			subfeature->mapping = get_int(r);
+			subfeature->flags = get_int(r);
+			if (r->err || subfeature->number != j ||
+			    subfeature->mapping < 0 ||
+			    subfeature->mapping >= chip->feature_count ||
+			    !valid_subfeature(chip, subfeature))
+				r->err = 1;
+		}
+		for (j = 0; j < chip->feature_count && !r->err; j++)
+			if (chip->subfeature[chip->feature[j].first_subfeature]
+			    .mapping != j)
+				r->err = 1;
+		if (!r->err)
+			sensors_alloc_sysfs_attrs(&chip->arena,
+						  &ctx->fd_cache, chip);
+	}
+}
+
+/* Check that nobody but us or root could have written the cache file, or
+   replaced it in its directory */
+static int cache_trusted(const struct stat *st)
+{
+	return (st->st_uid == 0 || st->st_uid == geteuid()) &&
+	       !(st->st_mode & (S_IWGRP | S_IWOTH));
+}
+
+static int rundir_trusted(void)
+{
+	struct stat st;
+
+	return !stat(RUNDIR, &st) && S_ISDIR(st.st_mode) && cache_trusted(&st);
+}
+
+/* The cache is written once the chips are read, but under the key of the
+   devices from before they were read: if a device is added or removed
+   meanwhile, the cache doesn't match it anymore */
+static void keep_key(sensors_ctx *ctx, struct cache_buf *key)
+{
+	if (access(RUNDIR, W_OK) || !rundir_trusted())
+		return;
+
+	ctx->cache_key = key->data;
+	ctx->cache_key_len = key->len;
+	key->data = NULL;
+}
+
+int sensors_read_cache(sensors_ctx *ctx)
+{
+	struct cache_buf key = { NULL, 0, 0 };
+	struct cache_reader r;
+	const char *magic, *cached_key;
+	struct stat st;
+	void *map;
+	int fd, key_len, err = -1;
+
+	if (cache_key(&key)) {
+		free(key.data);
+		return -1;
+	}
+
+	if (!rundir_trusted() ||
+	    (fd = open(SENSORS_CACHE_FILE, O_RDONLY | O_CLOEXEC)) < 0)
+		goto exit_free;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+	    !cache_trusted(&st) || !st.st_size)
+		goto exit_close;
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		goto exit_close;
+
+	r.p = map;
+	r.end = r.p + st.st_size;
+	r.err = 0;
+	r.ctx = ctx;
+
+	magic = get_str_ptr(&r);
+	if (!magic || strcmp(magic, CACHE_MAGIC))
+		goto exit_unmap;
+
+	/* Is the cache still valid? */
+	key_len = get_int(&r);
+	cached_key = r.p;
+	if (r.err || key_len < 0 || r.end - r.p < key_len ||
+	    (size_t)key_len != key.len ||
+	    memcmp(cached_key, key.data, key_len))
+		goto exit_unmap;
+	r.p += key_len;
+
+	read_bus(&r);
+	read_chips(&r);
+	if (!r.err && r.p == r.end)
+		err = 0;
+
+exit_unmap:
+	munmap(map, st.st_size);
+exit_close:
+	close(fd);
+exit_free:
+	if (err)
+		keep_key(ctx, &key);
+	free(key.data);
+	return err;
+}
+
+void sensors_free_cache_key(sensors_ctx *ctx)
+{
+	free(ctx->cache_key);
+	ctx->cache_key = NULL;
+	ctx->cache_key_len = 0;
+}
+
+void sensors_write_cache(sensors_ctx *ctx)
+{
+	struct cache_buf buf = { NULL, 0, 0 };
+	char tmp_name[] = SENSORS_CACHE_FILE ".XXXXXX";
+	const sensors_chip_list *list = sensors_proc_chips(ctx);
+	const sensors_chip_features *chip;
+	int i, j, count, fd;
+
+	if (!ctx->cache_key)
+		return;
+
+	buf_put_str(&buf, CACHE_MAGIC);
+	buf_put_int(&buf, ctx->cache_key_len);
+	buf_put(&buf, ctx->cache_key, ctx->cache_key_len);
+
+	buf_put_int(&buf, ctx->proc_bus_count);
+	for (i = 0; i < ctx->proc_bus_count; i++) {
+		buf_put_int(&buf, ctx->proc_bus[i].bus.type);
+		buf_put_int(&buf, ctx->proc_bus[i].bus.nr);
+		buf_put_str(&buf, ctx->proc_bus[i].adapter);
+	}
+
+	for (i = count = 0; i < list->count; i++)
+		if (list->chip[i]->subfeature_count)
+			count++;
+	buf_put_int(&buf, count);
+	for (i = 0; i < list->count; i++) {
+		chip = list->chip[i];
+		if (!chip->subfeature_count)	/* discarded */
+			continue;
+
+		buf_put_int(&buf, chip->chip.bus.type);
+		buf_put_int(&buf, chip->chip.bus.nr);
+		buf_put_int(&buf, chip->chip.addr);
+		buf_put_int(&buf, chip->feature_count);
+		buf_put_int(&buf, chip->subfeature_count);
+		buf_put_str(&buf, chip->chip.prefix);
+		buf_put_str(&buf, chip->chip.path);
+
+		for (j = 0; j < chip->feature_count; j++) {
+			buf_put_str(&buf, chip->feature[j].name);
+			buf_put_int(&buf, chip->feature[j].number);
+			buf_put_int(&buf, chip->feature[j].type);
+			buf_put_int(&buf, chip->feature[j].first_subfeature);
+		}
+		for (j = 0; j < chip->subfeature_count; j++) {
+			buf_put_str(&buf, chip->subfeature[j].name);
+			buf_put_int(&buf, chip->subfeature[j].number);
+			buf_put_int(&buf, chip->subfeature[j].type);
+			buf_put_int(&buf, chip->subfeature[j].mapping);
+			buf_put_int(&buf, chip->subfeature[j].flags);
+		}
+	}
+
+	/* Write to a temporary file and rename it, so that readers never
+	   see a partially written cache */
+	if ((fd = mkstemp(tmp_name)) < 0)
+		goto exit_free;
+	if (fchmod(fd, 0644) < 0 ||
+	    write(fd, buf.data, buf.len) != (ssize_t)buf.len) {
+		close(fd);
+		unlink(tmp_name);
+		goto exit_free;
+	}
+	if (close(fd) < 0 || rename(tmp_name, SENSORS_CACHE_FILE) < 0)
+		unlink(tmp_name);
+
+exit_free:
+	free(buf.data);
+	sensors_free_cache_key(ctx);
+}
@@ -0,0 +1,58 @@
+/*
+    cache.h - Part of libsensors, a Linux library for reading sensor data.
+    Copyright (C) 2026        The lm-sensors developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#ifndef LIB_SENSORS_CACHE_H
+#define LIB_SENSORS_CACHE_H
+
+/* The cache holds fixed-width fields, but in the byte order of the process
+   which wrote it, and its key holds inode numbers as that process sees
+   them. So each ABI has a cache of its own, rather than each process
+   rejecting the cache written by processes of another ABI. */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define SENSORS_CACHE_ENDIAN	"be"
+#else
+#define SENSORS_CACHE_ENDIAN	"le"
+#endif
+#if __SIZEOF_LONG__ == 8
+#define SENSORS_CACHE_BITS	"64"
+#else
+#define SENSORS_CACHE_BITS	"32"
+#endif
+#define SENSORS_CACHE_FILE	RUNDIR "/chips-" SENSORS_CACHE_BITS \
+				SENSORS_CACHE_ENDIAN ".cache"
+
+/* Fill the detected chips and i2c adapters lists from the cache. Returns 0
+   on success, !0 if the cache doesn't exist or is out of date. In the
+   latter case, the lists may be partially filled and must be freed, and
+   if the cache can be written, the key of the current devices is kept in
+   ctx for sensors_write_cache(). */
+int sensors_read_cache(sensors_ctx *ctx);
+
+/* Forget the key kept by sensors_read_cache(), when the chips of ctx
+   aren't meant to be saved, or no longer match it */
+void sensors_free_cache_key(sensors_ctx *ctx);
+
+/* Save the detected chips and i2c adapters lists to the cache, under the
+   key kept by sensors_read_cache(), if any, then forget it. Only the chips
+   with subfeatures are saved, so all of them must be loaded. Failing to
+   do so is not an error. */
+void sensors_write_cache(sensors_ctx *ctx);
+
+#endif /* def LIB_SENSORS_CACHE_H */
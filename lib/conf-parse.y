@@ -37,10 +37,12 @@ static sensors_expr *malloc_expr(void);
 
 static sensors_chip *current_chip = NULL;
 
+sensors_ctx *sensors_parse_ctx = &sensors_default_ctx;
+
 #define bus_add_el(el) sensors_add_array_el(el,\
-                                      &sensors_config_busses,\
-                                      &sensors_config_busses_count,\
-                                      &sensors_config_busses_max,\
+                                      &sensors_parse_ctx->config_busses,\
+                                      &sensors_parse_ctx->config_busses_count,\
+                                      &sensors_parse_ctx->config_busses_max,\
                                       sizeof(sensors_bus))
 #define label_add_el(el) sensors_add_array_el(el,\
                                         &current_chip->labels,\
@@ -63,9 +65,9 @@ static sensors_chip *current_chip = NULL;
                                           &current_chip->ignores_max,\
                                           sizeof(sensors_ignore));
 #define chip_add_el(el) sensors_add_array_el(el,\
-                                       &sensors_config_chips,\
-                                       &sensors_config_chips_count,\
-                                       &sensors_config_chips_max,\
+                                       &sensors_parse_ctx->config_chips,\
+                                       &sensors_parse_ctx->config_chips_count,\
+                                       &sensors_parse_ctx->config_chips_max,\
                                        sizeof(sensors_chip));
 
 #define fits_add_el(el,list) sensors_add_array_el(el,\
@@ -211,8 +213,8 @@ chip_statement:	  CHIP chip_name_list
 		    new_el.ignores_count = new_el.ignores_max = 0;
 		    new_el.chips = $2;
 		    chip_add_el(&new_el);
-		    current_chip = sensors_config_chips + 
-		                   sensors_config_chips_count - 1;
+		    current_chip = sensors_parse_ctx->config_chips + 
+		                   sensors_parse_ctx->config_chips_count - 1;
 		  }
 ;
 
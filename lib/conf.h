@@ -30,5 +30,8 @@ extern FILE *sensors_yyin;
 
 /* This is defined in conf-parse.y */
 int sensors_yyparse(void);
+/* The context the configuration is parsed into. The parser isn't
+   reentrant, so this is only changed with sensors_parse_lock held. */
+extern struct sensors_ctx *sensors_parse_ctx;
 
 #endif /* def LIB_SENSORS_CONF_H */
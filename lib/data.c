@@ -33,26 +33,8 @@
 
 const char *libsensors_version = LM_VERSION;
 
-char **sensors_config_files = NULL;
-int sensors_config_files_count = 0;
-int sensors_config_files_max = 0;
-
-sensors_chip *sensors_config_chips = NULL;
-int sensors_config_chips_count = 0;
-int sensors_config_chips_subst = 0;
-int sensors_config_chips_max = 0;
-
-sensors_bus *sensors_config_busses = NULL;
-int sensors_config_busses_count = 0;
-int sensors_config_busses_max = 0;
-
-sensors_chip_features *sensors_proc_chips = NULL;
-int sensors_proc_chips_count = 0;
-int sensors_proc_chips_max = 0;
-
-sensors_bus *sensors_proc_bus = NULL;
-int sensors_proc_bus_count = 0;
-int sensors_proc_bus_max = 0;
+sensors_pins sensors_default_pins = SENSORS_PINS_INITIALIZER;
+sensors_ctx sensors_default_ctx = SENSORS_CTX_INITIALIZER;
 
 void sensors_free_chip_name(sensors_chip_name *chip)
 {
@@ -224,16 +206,17 @@ int sensors_parse_bus_id(const char *name, sensors_bus_id *bus)
 	return 0;
 }
 
-static int sensors_substitute_chip(sensors_chip_name *name,
+static int sensors_substitute_chip(const sensors_ctx *ctx,
+				   sensors_chip_name *name,
 				   const char *filename, int lineno)
 {
 	int i, j;
-	for (i = 0; i < sensors_config_busses_count; i++)
-		if (sensors_config_busses[i].bus.type == name->bus.type &&
-		    sensors_config_busses[i].bus.nr == name->bus.nr)
+	for (i = 0; i < ctx->config_busses_count; i++)
+		if (ctx->config_busses[i].bus.type == name->bus.type &&
+		    ctx->config_busses[i].bus.nr == name->bus.nr)
 			break;
 
-	if (i == sensors_config_busses_count) {
+	if (i == ctx->config_busses_count) {
 		sensors_parse_error_wfn("Undeclared bus id referenced",
 					filename, lineno);
 		name->bus.nr = SENSORS_BUS_NR_IGNORE;
@@ -241,10 +224,10 @@ static int sensors_substitute_chip(sensors_chip_name *name,
 	}
 
 	/* Compare the adapter names */
-	for (j = 0; j < sensors_proc_bus_count; j++) {
-		if (!strcmp(sensors_config_busses[i].adapter,
-			    sensors_proc_bus[j].adapter)) {
-			name->bus.nr = sensors_proc_bus[j].bus.nr;
+	for (j = 0; j < ctx->proc_bus_count; j++) {
+		if (!strcmp(ctx->config_busses[i].adapter,
+			    ctx->proc_bus[j].adapter)) {
+			name->bus.nr = ctx->proc_bus[j].bus.nr;
 			return 0;
 		}
 	}
@@ -256,32 +239,32 @@ static int sensors_substitute_chip(sensors_chip_name *name,
 }
 
 /* Bus substitution is on a per-configuration file basis, so we keep
-   memory (in sensors_config_chips_subst) of which chip entries have been
+   memory (in config_chips_subst) of which chip entries have been
    already substituted. */
-int sensors_substitute_busses(void)
+int sensors_substitute_busses(sensors_ctx *ctx)
 {
 	int err, i, j, lineno;
 	sensors_chip_name_list *chips;
 	const char *filename;
 	int res = 0;
 
-	for (i = sensors_config_chips_subst;
-	     i < sensors_config_chips_count; i++) {
-		filename = sensors_config_chips[i].line.filename;
-		lineno = sensors_config_chips[i].line.lineno;
-		chips = &sensors_config_chips[i].chips;
+	for (i = ctx->config_chips_subst;
+	     i < ctx->config_chips_count; i++) {
+		filename = ctx->config_chips[i].line.filename;
+		lineno = ctx->config_chips[i].line.lineno;
+		chips = &ctx->config_chips[i].chips;
 		for (j = 0; j < chips->fits_count; j++) {
 			/* We can only substitute if a specific bus number
 			   is given. */
 			if (chips->fits[j].bus.nr == SENSORS_BUS_NR_ANY)
 				continue;
 
-			err = sensors_substitute_chip(&chips->fits[j],
+			err = sensors_substitute_chip(ctx, &chips->fits[j],
 						      filename, lineno);
 			if (err)
 				res = err;
 		}
 	}
-	sensors_config_chips_subst = sensors_config_chips_count;
+	ctx->config_chips_subst = ctx->config_chips_count;
 	return res;
 }
@@ -130,51 +130,255 @@ typedef struct sensors_bus {
 	sensors_config_line line;
 } sensors_bus;
 
-/* Internal data about all features and subfeatures of a chip */
+/* Cached file descriptor of a subfeature attribute, see sysfs.c */
+typedef struct sensors_attr_fd {
+	/* fd + 1 (0 if not open), number of reads in progress, and whether
+	   the last of them must close it, updated atomically */
+	unsigned long long state;
+	int used;		/* read since the eviction hand last passed */
+	int closed;		/* the chip was removed, don't cache anymore */
+	int in_ring;		/* protected by the lock of the fd cache */
+} sensors_attr_fd;
+
+/* The attribute files a context keeps open, in the order the eviction
+   hand goes through them. Only cache misses and evictions take the lock. */
+typedef struct sensors_fd_cache {
+	pthread_mutex_t lock;
+	sensors_attr_fd **ring;
+	int count;
+	int max;
+	int hand;
+} sensors_fd_cache;
+
+/* The values last read from the attributes of a chip. Measurements are
+   read again once older than the update interval of the chip, or than the
+   cache time set by the application if longer. Limits and other settings
+   are kept longer, see sysfs.c. */
+typedef struct sensors_value_cache {
+	int update_interval;	/* in ms, -1 until first needed */
+	int cache_time;		/* in ms, see sensors_set_cache_time() */
+	unsigned int flushes;	/* incremented to drop all the values */
+	long long suspended;	/* CLOCK_BOOTTIME - CLOCK_MONOTONIC, in ns */
+	struct sensors_cached_value {
+		unsigned int seq;	/* odd while being updated */
+		unsigned int flushes;	/* valid while it is the above */
+		long long time;	/* CLOCK_MONOTONIC, in ns; 0 if none */
+		long long end;	/* when the read ended, likewise */
+		int exact;	/* raw is valid, the value is an integer */
+		long long raw;
+		double value;
+	} value[];		/* one per subfeature */
+} sensors_value_cache;
+
+struct sensors_prog;
+
+/* The compute statement which applies to a feature, compiled for the
+   chip. Both programs are NULL if there is none. */
+typedef struct sensors_feature_compute {
+	const struct sensors_prog *from_proc;
+	const struct sensors_prog *to_proc;
+} sensors_feature_compute;
+
+struct sensors_chip_features;
+
+/* Handle of a subfeature of a detected chip: everything needed to read or
+   write it, resolved once. See sensors_get_sf_handle(). */
+struct sensors_sf_handle {
+	struct sensors_chip_handle *chip;
+	const sensors_subfeature *subfeature;
+	const struct sensors_prog *from_proc;	/* NULL if no compute */
+	const struct sensors_prog *to_proc;
+	int scale;
+};
+
+/* The calls in progress on a context, see sensors_pin() in init.c. The
+   counters are spread over cache lines, one per CPU modulo the number of
+   shards, so that calls running on different CPUs don't keep writing to
+   the same line. */
+#define SENSORS_PIN_SHARDS	16
+#define SENSORS_CACHE_LINE	64
+
+typedef struct sensors_pins {
+	struct sensors_pin_shard {
+		int count[2];		/* calls in progress, per slot */
+	} __attribute__((aligned(SENSORS_CACHE_LINE)))
+	shard[SENSORS_PIN_SHARDS];
+	unsigned int epoch;		/* low bit: slot of new calls */
+	pthread_mutex_t sync_lock;	/* serializes sensors_synchronize() */
+} sensors_pins;
+
+#define SENSORS_PINS_INITIALIZER { .sync_lock = PTHREAD_MUTEX_INITIALIZER }
+
+/* Handle of a detected chip, see sensors_get_chip_handle(). Unlike the
+   chip itself, it remains once the chip is removed, or once the generation
+   of the default context it comes from is freed; chip is then set to NULL,
+   see sensors_handle_chip(). It is freed with the last of its references:
+   that of the chip, those of the plans and watches using it, and those of
+   the callers of sensors_get_chip_handle(). */
+struct sensors_chip_handle {
+	sensors_pins *pins;		/* those of the context */
+	struct sensors_chip_features *chip;
+	struct sensors_sf_handle *sf;		/* one per subfeature */
+	int refs;
+};
+
+/* The chip of a handle, NULL once removed. The chip remains valid until
+   the caller unpins. */
+#define sensors_handle_chip(handle) \
+	__atomic_load_n(&(handle)->chip, __ATOMIC_ACQUIRE)
+
+/* Internal data about all features and subfeatures of a chip. The
+   detected chips are allocated one by one, and all the memory they point
+   to comes from their own arena, except for their handle which may
+   outlive them. See sensors_alloc_proc_chip(). */
 typedef struct sensors_chip_features {
 	struct sensors_chip_name chip;
+	sensors_arena arena;
+	/* Only the chip name is read at initialization time (or the chip
+	   is restored from the cache), the rest of the chip is read (or
+	   checked) by sensors_load_chips() when first needed. Set once it
+	   is, never cleared. */
+	int loaded;
+	/* Set, under the load_lock of the context, once the chip is removed
+	   from the chips list. It is no longer loaded then. */
+	int removed;
 	struct sensors_feature *feature;
 	struct sensors_subfeature *subfeature;
 	int feature_count;
 	int subfeature_count;
+	sensors_attr_fd *attr_fd;	/* one per subfeature */
+	sensors_fd_cache *fd_cache;	/* the one of the context */
+	sensors_value_cache *value_cache;
+	/* compiled compute statement of each feature, or NULL if none
+	   applies to any feature; set by sensors_resolve_config() */
+	sensors_feature_compute *compute;
+	int compute_vars;	/* compute statements reference subfeatures */
+	/* label of each feature, resolved on first use */
+	const char **label;
+	/* bitmap of the features ignored by the configuration, or NULL if
+	   there are none, and the features which aren't; set by
+	   sensors_resolve_config() */
+	unsigned long *ignored;
+	const sensors_feature **visible;
+	int visible_count;
+	/* set by sensors_resolve_config(), NULL if the chip has no
+	   subfeatures */
+	struct sensors_chip_handle *handle;
 } sensors_chip_features;
 
-extern char **sensors_config_files;
-extern int sensors_config_files_count;
-extern int sensors_config_files_max;
-
-#define sensors_add_config_files(el) sensors_add_array_el( \
-	(el), &sensors_config_files, &sensors_config_files_count, \
-	&sensors_config_files_max, sizeof(char *))
-
-extern sensors_chip *sensors_config_chips;
-extern int sensors_config_chips_count;
-extern int sensors_config_chips_subst;
-extern int sensors_config_chips_max;
-
-extern sensors_bus *sensors_config_busses;
-extern int sensors_config_busses_count;
-extern int sensors_config_busses_max;
-
-extern sensors_chip_features *sensors_proc_chips;
-extern int sensors_proc_chips_count;
-extern int sensors_proc_chips_max;
-
-#define sensors_add_proc_chips(el) sensors_add_array_el( \
-	(el), &sensors_proc_chips, &sensors_proc_chips_count,\
-	&sensors_proc_chips_max, sizeof(struct sensors_chip_features))
-
-extern sensors_bus *sensors_proc_bus;
-extern int sensors_proc_bus_count;
-extern int sensors_proc_bus_max;
-
-#define sensors_add_proc_bus(el) sensors_add_array_el( \
-	(el), &sensors_proc_bus, &sensors_proc_bus_count,\
-	&sensors_proc_bus_max, sizeof(struct sensors_bus))
+/* A list of detected chips, and their index by name */
+typedef struct sensors_chip_list {
+	sensors_chip_features **chip;
+	int count;
+	int max;
+
+	/* Open addressing hash table of the chips, by name. Each slot holds
+	   a chip index plus one, 0 if the slot is free. */
+	int *index;
+	int index_size;
+} sensors_chip_list;
+
+/* A libsensors context: a configuration and the chips it applies to. The
+   original API works on the current generation of the default context,
+   the first of which is sensors_default_ctx. */
+struct sensors_ctx {
+	char **config_files;
+	int config_files_count;
+	int config_files_max;
+
+	sensors_chip *config_chips;
+	int config_chips_count;
+	int config_chips_subst;
+	int config_chips_max;
+
+	/* Only used while parsing a configuration file */
+	sensors_bus *config_busses;
+	int config_busses_count;
+	int config_busses_max;
+
+	/* The detected chips: chip_lists[proc_chips], see
+	   sensors_proc_chips(). The published list is never modified, so
+	   that it can be read without locking. Hotplug builds the changed
+	   list in the other one, and publishes it instead. */
+	sensors_chip_list chip_lists[2];
+	int proc_chips;
+
+	/* The chips removed by the last sensors_hotplug_process() call,
+	   freed by the next one */
+	sensors_chip_features **removed_chips;
+	int removed_chips_count;
+	int removed_chips_max;
+
+	/* The calls in progress: ctx_pins, except for the generations of
+	   the default context, which are all pinned through
+	   sensors_default_pins, see sensors_reload() */
+	sensors_pins ctx_pins;
+	sensors_pins *pins;
+
+	sensors_bus *proc_bus;
+	int proc_bus_count;
+	int proc_bus_max;
+
+	/* Protects the resolution of the labels of the detected chips */
+	pthread_mutex_t label_lock;
+
+	/* Serializes the loading of the detected chips */
+	pthread_mutex_t load_lock;
+
+	/* Serializes sensors_hotplug_process() calls */
+	pthread_mutex_t hotplug_lock;
+	int resolved;		/* sensors_resolve_config() was called */
+
+	int cache_time;		/* see sensors_set_cache_time() */
+
+	/* Options given to sensors_init_ex() */
+	int flags;
+	sensors_chip_name *match;	/* chips to detect, all if NULL */
+	int match_count;
+
+	/* Key of the cache, kept until all the chips are loaded and the
+	   cache can be written, see sensors_read_cache() */
+	char *cache_key;
+	size_t cache_key_len;
+
+	/* Incremented whenever the chips list changes */
+	unsigned int chips_generation;
+
+	/* The attribute files kept open for the chips */
+	sensors_fd_cache fd_cache;
+};
+
+#define SENSORS_CTX_INITIALIZER	{ .ctx_pins = SENSORS_PINS_INITIALIZER, \
+				  .pins = &sensors_default_pins, \
+				  .label_lock = PTHREAD_MUTEX_INITIALIZER, \
+				  .load_lock = PTHREAD_MUTEX_INITIALIZER, \
+				  .hotplug_lock = PTHREAD_MUTEX_INITIALIZER, \
+				  .fd_cache.lock = PTHREAD_MUTEX_INITIALIZER }
+
+extern sensors_ctx sensors_default_ctx;
+extern sensors_pins sensors_default_pins;
+
+#define sensors_add_config_files(ctx, el) sensors_add_array_el( \
+	(el), &(ctx)->config_files, &(ctx)->config_files_count, \
+	&(ctx)->config_files_max, sizeof(char *))
+
+/* The published chips list of ctx. Chips may be removed from it by
+   sensors_hotplug_process(), but the list and its chips remain valid until
+   the caller unpins. */
+#define sensors_proc_chips(ctx) (&(ctx)->chip_lists[ \
+	__atomic_load_n(&(ctx)->proc_chips, __ATOMIC_ACQUIRE)])
+
+#define sensors_add_proc_chips(list, el) sensors_add_array_el( \
+	(el), &(list)->chip, &(list)->count, &(list)->max, \
+	sizeof(struct sensors_chip_features *))
+
+#define sensors_add_proc_bus(ctx, el) sensors_add_array_el( \
+	(el), &(ctx)->proc_bus, &(ctx)->proc_bus_count, \
+	&(ctx)->proc_bus_max, sizeof(struct sensors_bus))
 
 /* Substitute configuration bus numbers with real-world bus numbers
    in the chips lists */
-int sensors_substitute_busses(void);
+int sensors_substitute_busses(sensors_ctx *ctx);
 
 
 /* Parse a bus id into its components. Returns 0 on success, a value from
@@ -0,0 +1,276 @@
+/*
+    expr.c - Part of libsensors, a Linux library for reading sensor data.
+    Copyright (C) 2026        The lm-sensors developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+/*
+ * Compiler and interpreter for the expressions of compute and set
+ * statements
+ *
+ * Expressions are compiled when the configuration is resolved against the
+ * detected chips, so that evaluating them doesn't involve walking a tree
+ * or looking up variables by name.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sensors.h"
+#include "data.h"
+#include "error.h"
+#include "general.h"
+#include "access.h"
+#include "expr.h"
+
+/* Most expressions need 2 or 3 stack slots. Programs which need more than
+   this fail, so that running them never allocates memory. */
+#define STACK_MAX	16
+
+struct compiler {
+	const sensors_chip_features *chip;
+	sensors_insn *insn;
+	int len, max;
+	int depth, max_depth;
+	int vars;
+};
+
+static void emit(struct compiler *c, const sensors_insn *insn, int pushed)
+{
+	sensors_add_array_el(insn, &c->insn, &c->len, &c->max,
+			     sizeof(sensors_insn));
+	c->depth += pushed;
+	if (c->depth > c->max_depth)
+		c->max_depth = c->depth;
+}
+
+/* Apply an operation to constant operands. Returns 0 on success, <0 if the
+   operation fails. */
+static int apply_op(sensors_opcode op, double v1, double v2, double *result)
+{
+	switch (op) {
+	case sensors_op_add:
+		*result = v1 + v2;
+		break;
+	case sensors_op_sub:
+		*result = v1 - v2;
+		break;
+	case sensors_op_multiply:
+		*result = v1 * v2;
+		break;
+	case sensors_op_divide:
+		if (v2 == 0.0)
+			return -SENSORS_ERR_DIV_ZERO;
+		*result = v1 / v2;
+		break;
+	case sensors_op_negate:
+		*result = -v1;
+		break;
+	case sensors_op_exp:
+		*result = exp(v1);
+		break;
+	case sensors_op_log:
+		if (v1 < 0.0)
+			return -SENSORS_ERR_DIV_ZERO;
+		*result = log(v1);
+		break;
+	default:
+		break;
+	}
+	return 0;
+}
+
+static sensors_opcode get_opcode(sensors_operation op)
+{
+	switch (op) {
+	case sensors_add:
+		return sensors_op_add;
+	case sensors_sub:
+		return sensors_op_sub;
+	case sensors_multiply:
+		return sensors_op_multiply;
+	case sensors_divide:
+		return sensors_op_divide;
+	case sensors_negate:
+		return sensors_op_negate;
+	case sensors_exp:
+		return sensors_op_exp;
+	case sensors_log:
+	default:
+		return sensors_op_log;
+	}
+}
+
+/* Compile an expression, and return 1 if it compiled to a constant, so
+   that the caller can fold it */
+static int compile(struct compiler *c, const sensors_expr *expr)
+{
+	sensors_insn insn;
+	int i, binary, constant;
+	double v1, v2;
+
+	memset(&insn, 0, sizeof(insn));
+
+	switch (expr->kind) {
+	case sensors_kind_val:
+		insn.op = sensors_op_val;
+		insn.arg.val = expr->data.val;
+		emit(c, &insn, 1);
+		return 1;
+	case sensors_kind_source:
+		insn.op = sensors_op_source;
+		emit(c, &insn, 1);
+		return 0;
+	case sensors_kind_var:
+		for (i = 0; i < c->chip->subfeature_count; i++)
+			if (!strcmp(c->chip->subfeature[i].name,
+				    expr->data.var))
+				break;
+		if (i < c->chip->subfeature_count) {
+			insn.op = sensors_op_var;
+			insn.arg.nr = i;
+			c->vars++;
+		} else {
+			/* Only an error if evaluated */
+			insn.op = sensors_op_fail;
+			insn.arg.err = -SENSORS_ERR_NO_ENTRY;
+		}
+		emit(c, &insn, 1);
+		return 0;
+	case sensors_kind_sub:
+		break;
+	}
+
+	binary = expr->data.subexpr.sub2 != NULL;
+	constant = compile(c, expr->data.subexpr.sub1);
+	if (binary)
+		constant &= compile(c, expr->data.subexpr.sub2);
+
+	insn.op = get_opcode(expr->data.subexpr.op);
+	if (constant) {
+		v1 = c->insn[c->len - 1 - binary].arg.val;
+		v2 = binary ? c->insn[c->len - 1].arg.val : 0;
+		if (!apply_op(insn.op, v1, v2, &insn.arg.val)) {
+			/* Replace the operands with the result */
+			c->len -= binary + 1;
+			c->depth -= binary + 1;
+			insn.op = sensors_op_val;
+			emit(c, &insn, 1);
+			return 1;
+		}
+		/* Errors are left for evaluation time */
+	}
+	emit(c, &insn, -binary);
+	return 0;
+}
+
+sensors_prog *sensors_compile_expr(const sensors_chip_features *chip,
+				   const sensors_expr *expr,
+				   sensors_arena *arena)
+{
+	struct compiler c = { chip, NULL, 0, 0, 0, 0, 0 };
+	sensors_prog *prog;
+
+	compile(&c, expr);
+	if (c.max_depth > STACK_MAX) {
+		free(c.insn);
+		return sensors_fail_prog(-SENSORS_ERR_RECURSION, arena);
+	}
+
+	prog = sensors_arena_alloc(arena, sizeof(sensors_prog) +
+				   c.len * sizeof(sensors_insn));
+	prog->len = c.len;
+	prog->stack_size = c.max_depth;
+	prog->vars = c.vars;
+	memcpy(prog->insn, c.insn, c.len * sizeof(sensors_insn));
+	free(c.insn);
+
+	return prog;
+}
+
+sensors_prog *sensors_fail_prog(int err, sensors_arena *arena)
+{
+	sensors_prog *prog;
+
+	prog = sensors_arena_alloc(arena, sizeof(sensors_prog) +
+				   sizeof(sensors_insn));
+	prog->len = 1;
+	prog->stack_size = 0;
+	prog->vars = 0;
+	prog->insn[0].op = sensors_op_fail;
+	prog->insn[0].arg.err = err;
+
+	return prog;
+}
+
+int sensors_run_prog(sensors_snapshot *snapshot,
+		     const sensors_prog *prog, double val, double *result)
+{
+	double stack[STACK_MAX], *sp = stack;
+	const sensors_insn *insn, *end;
+	int res;
+
+	for (insn = prog->insn, end = insn + prog->len; insn < end; insn++) {
+		switch (insn->op) {
+		case sensors_op_val:
+			*sp++ = insn->arg.val;
+			break;
+		case sensors_op_source:
+			*sp++ = val;
+			break;
+		case sensors_op_var:
+			if ((res = sensors_read_snapshot_value(snapshot,
+							       insn->arg.nr, sp)))
+				return res;
+			sp++;
+			break;
+		case sensors_op_fail:
+			return insn->arg.err;
+		case sensors_op_add:
+			sp--;
+			sp[-1] += sp[0];
+			break;
+		case sensors_op_sub:
+			sp--;
+			sp[-1] -= sp[0];
+			break;
+		case sensors_op_multiply:
+			sp--;
+			sp[-1] *= sp[0];
+			break;
+		case sensors_op_divide:
+			sp--;
+			if (sp[0] == 0.0)
+				return -SENSORS_ERR_DIV_ZERO;
+			sp[-1] /= sp[0];
+			break;
+		case sensors_op_negate:
+			sp[-1] = -sp[-1];
+			break;
+		case sensors_op_exp:
+			sp[-1] = exp(sp[-1]);
+			break;
+		case sensors_op_log:
+			if (sp[-1] < 0.0)
+				return -SENSORS_ERR_DIV_ZERO;
+			sp[-1] = log(sp[-1]);
+			break;
+		}
+	}
+	*result = sp[-1];
+	return 0;
+}
@@ -0,0 +1,74 @@
+/*
+    expr.h - Part of libsensors, a Linux library for reading sensor data.
+    Copyright (C) 2026        The lm-sensors developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#ifndef LIB_SENSORS_EXPR_H
+#define LIB_SENSORS_EXPR_H
+
+#include "data.h"
+#include "general.h"
+
+/* Expressions are compiled to programs for a small stack machine. The
+   operations take their operands from the top of the stack and replace
+   them with their result. */
+typedef enum sensors_opcode {
+	sensors_op_val,		/* push arg.val */
+	sensors_op_source,	/* push the raw value ('@') */
+	sensors_op_var,		/* push the value of subfeature arg.nr */
+	sensors_op_fail,	/* fail with error arg.err */
+	sensors_op_add, sensors_op_sub, sensors_op_multiply,
+	sensors_op_divide, sensors_op_negate, sensors_op_exp, sensors_op_log,
+} sensors_opcode;
+
+typedef struct sensors_insn {
+	sensors_opcode op;
+	union {
+		double val;
+		int nr;
+		int err;
+	} arg;
+} sensors_insn;
+
+typedef struct sensors_prog {
+	int len;
+	int stack_size;		/* maximum stack depth */
+	int vars;		/* number of sensors_op_var instructions */
+	sensors_insn insn[];
+} sensors_prog;
+
+/* Compile an expression for a given chip. Variables are resolved to
+   subfeatures of the chip, and constant subexpressions are folded. The
+   program is allocated from arena. Expressions nested too deep compile to
+   a program which fails with -SENSORS_ERR_RECURSION. */
+sensors_prog *sensors_compile_expr(const sensors_chip_features *chip,
+				   const sensors_expr *expr,
+				   sensors_arena *arena);
+
+/* Return a program which fails with error err */
+sensors_prog *sensors_fail_prog(int err, sensors_arena *arena);
+
+struct sensors_snapshot;
+
+/* Run a program compiled for the chip of snapshot, val being the value of
+   '@'. Variables are read through snapshot. This function will return 0
+   on success, and <0 on failure. */
+int sensors_run_prog(struct sensors_snapshot *snapshot,
+		     const sensors_prog *prog, double val, double *result);
+
+#endif /* def LIB_SENSORS_EXPR_H */
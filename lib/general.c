@@ -83,3 +83,81 @@ void sensors_add_array_els(const void *els, int nr_els, void *list,
 	memcpy(((char *)*my_list) + *num_el * el_size, els, el_size * nr_els);
 	*num_el += nr_els;
 }
+
+/* Blocks start small and double in size up to ARENA_BLOCK_SIZE, as each
+   detected chip has an arena of its own, and most only need a few kB */
+#define ARENA_MIN_BLOCK_SIZE	1024
+#define ARENA_BLOCK_SIZE	16384
+#define ARENA_ALIGN		16
+
+struct sensors_arena_block {
+	struct sensors_arena_block *next;
+	size_t size, used;
+	char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+void sensors_arena_init(sensors_arena *arena)
+{
+	arena->block = NULL;
+	pthread_mutex_init(&arena->lock, NULL);
+}
+
+void *sensors_arena_alloc(sensors_arena *arena, size_t size)
+{
+	struct sensors_arena_block *block;
+	size_t block_size;
+	int dedicated;
+	void *p;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	pthread_mutex_lock(&arena->lock);
+	block = arena->block;
+	if (!block || block->size - block->used < size) {
+		block_size = block ? 2 * block->size : ARENA_MIN_BLOCK_SIZE;
+		if (block_size > ARENA_BLOCK_SIZE)
+			block_size = ARENA_BLOCK_SIZE;
+		dedicated = size > block_size;
+		if (dedicated)
+			block_size = size;
+		block = calloc(1, sizeof(*block) + block_size);
+		if (!block)
+			sensors_fatal_error(__func__, "Out of memory");
+		block->size = block_size;
+
+		/* Keep filling the current block if the new one is a
+		   dedicated one */
+		if (arena->block && dedicated) {
+			block->next = arena->block->next;
+			arena->block->next = block;
+		} else {
+			block->next = arena->block;
+			arena->block = block;
+		}
+	}
+	p = block->data + block->used;
+	block->used += size;
+	pthread_mutex_unlock(&arena->lock);
+
+	return p;
+}
+
+char *sensors_arena_strdup(sensors_arena *arena, const char *str)
+{
+	size_t len = strlen(str) + 1;
+
+	return memcpy(sensors_arena_alloc(arena, len), str, len);
+}
+
+void sensors_arena_free(sensors_arena *arena)
+{
+	struct sensors_arena_block *block, *next;
+
+	pthread_mutex_lock(&arena->lock);
+	for (block = arena->block; block; block = next) {
+		next = block->next;
+		free(block);
+	}
+	arena->block = NULL;
+	pthread_mutex_unlock(&arena->lock);
+}
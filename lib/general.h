@@ -21,6 +21,9 @@
 #ifndef LIB_SENSORS_GENERAL_H
 #define LIB_SENSORS_GENERAL_H
 
+#include <stddef.h>
+#include <pthread.h>
+
 /* These are general purpose functions. They allow you to use variable-
    length arrays, which are extended automatically. A distinction is
    made between the current number of elements and the maximum number.
@@ -36,4 +39,21 @@ void sensors_add_array_els(const void *els, int nr_els, void *list,
 
 #define ARRAY_SIZE(arr)	(int)(sizeof(arr) / sizeof((arr)[0]))
 
+/* An arena hands out memory from large blocks, which are only freed all
+   at once. Allocated memory is zeroed. Allocations may be done from
+   several threads at the same time. */
+struct sensors_arena_block;
+
+typedef struct sensors_arena {
+	struct sensors_arena_block *block;
+	pthread_mutex_t lock;
+} sensors_arena;
+
+#define SENSORS_ARENA_INITIALIZER	{ NULL, PTHREAD_MUTEX_INITIALIZER }
+
+void sensors_arena_init(sensors_arena *arena);
+void *sensors_arena_alloc(sensors_arena *arena, size_t size);
+char *sensors_arena_strdup(sensors_arena *arena, const char *str);
+void sensors_arena_free(sensors_arena *arena);
+
 #endif /* def LIB_SENSORS_GENERAL_H */
@@ -0,0 +1,352 @@
+/*
+    hotplug.c - Part of libsensors, a Linux library for reading sensor data.
+    Copyright (C) 2026        The lm-sensors developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+/*
+ * Hotplug support
+ *
+ * The kernel sends a uevent whenever a hwmon class device is added or
+ * removed. Applications which want to follow these changes open a uevent
+ * socket with sensors_hotplug_open(), and call sensors_hotplug_process()
+ * when it is readable. Only the chip the event is about is read from
+ * sysfs, or removed from the chips list. If the socket buffer overflowed
+ * and events were lost, all the chips are read again.
+ *
+ * Other threads keep reading the published chips list meanwhile. The
+ * changes are applied to a copy of it, which is then published instead.
+ * The chips removed are freed by the next call, once no call which could
+ * have found them is still running, see sensors_synchronize().
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <dirent.h>
+#include "sensors.h"
+#include "data.h"
+#include "error.h"
+#include "access.h"
+#include "sysfs.h"
+#include "init.h"
+#include "cache.h"
+#include "hotplug.h"
+
+#define UEVENT_MAX	8192
+
+int sensors_hotplug_open(void)
+{
+	struct sockaddr_nl addr;
+	int fd;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+		    NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		return -SENSORS_ERR_KERNEL;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = 1;	/* events from the kernel, not from udev */
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -SENSORS_ERR_KERNEL;
+	}
+
+	return fd;
+}
+
+/* Get the chips list the events of this call are applied to: a copy of
+   the published one, made on the first change */
+static sensors_chip_list *sensors_begin_changes(sensors_ctx *ctx)
+{
+	const sensors_chip_list *cur = sensors_proc_chips(ctx);
+	sensors_chip_list *list = &ctx->chip_lists[!ctx->proc_chips];
+	int i;
+
+	/* The calls which could still see the chips removed by the previous
+	   call, or the list we are about to overwrite, are gone once this
+	   returns */
+	sensors_synchronize(ctx->pins);
+	for (i = 0; i < ctx->removed_chips_count; i++)
+		sensors_free_proc_chip(ctx->removed_chips[i]);
+	ctx->removed_chips_count = 0;
+
+	/* The chips will no longer match the devices the cache would have
+	   been saved for, and the settings of those we keep may have been
+	   changed along with the devices */
+	pthread_mutex_lock(&ctx->load_lock);
+	sensors_free_cache_key(ctx);
+	for (i = 0; i < cur->count; i++)
+		if (cur->chip[i]->loaded)
+			sensors_flush_sysfs_values(cur->chip[i]);
+	pthread_mutex_unlock(&ctx->load_lock);
+
+	list->count = 0;
+	for (i = 0; i < cur->count; i++)
+		sensors_add_proc_chips(list, &cur->chip[i]);
+	return list;
+}
+
+/* Remove chip i from list */
+static void sensors_remove_chip_nr(sensors_ctx *ctx, sensors_chip_list *list,
+				   int i)
+{
+	sensors_chip_features *chip = list->chip[i];
+
+	/* Readers which still find the chip don't load it any longer, and
+	   those which have its handle see it is gone */
+	pthread_mutex_lock(&ctx->load_lock);
+	chip->removed = 1;
+	sensors_close_sysfs_attrs(chip);
+	if (chip->handle)
+		__atomic_store_n(&chip->handle->chip, NULL, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&ctx->load_lock);
+
+	memmove(&list->chip[i], &list->chip[i + 1],
+		(list->count - i - 1) * sizeof(*list->chip));
+	list->count--;
+	sensors_add_array_el(&chip, &ctx->removed_chips,
+			     &ctx->removed_chips_count,
+			     &ctx->removed_chips_max, sizeof(chip));
+}
+
+/* Remove the chip read from hwmon class device name from list, if any.
+   Returns the number of chips removed (0 or 1). */
+static int sensors_remove_chip(sensors_ctx *ctx, sensors_chip_list *list,
+			       const char *name)
+{
+	char path[PATH_MAX];
+	const char *chip_path;
+	int i, len;
+
+	len = snprintf(path, sizeof(path), "%s/class/hwmon/%s",
+		       sensors_sysfs_mount, name);
+	if (len >= (int)sizeof(path))
+		return 0;
+
+	/* The attributes may be those of the device itself */
+	for (i = 0; i < list->count; i++) {
+		chip_path = list->chip[i]->chip.path;
+		if (!strncmp(chip_path, path, len) &&
+		    (chip_path[len] == '\0' || chip_path[len] == '/')) {
+			sensors_remove_chip_nr(ctx, list, i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Some events were lost, so we can't tell which devices were added or
+   removed, or removed and added again meanwhile. Read all the chips
+   again. Returns the number of chips added or removed, or <0 on error. */
+static int sensors_rescan_chips(sensors_ctx *ctx, sensors_chip_list *list)
+{
+	char path[PATH_MAX];
+	DIR *dir;
+	struct dirent *ent;
+	int res, changes = 0, err = 0;
+
+	if (snprintf(path, sizeof(path), "%s/class/hwmon",
+		     sensors_sysfs_mount) >= (int)sizeof(path) ||
+	    !(dir = opendir(path)))
+		return -SENSORS_ERR_KERNEL;
+
+	while (list->count) {
+		sensors_remove_chip_nr(ctx, list, list->count - 1);
+		changes++;
+	}
+
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')
+			continue;
+		res = sensors_read_sysfs_chip(ctx, list, ent->d_name);
+		if (res < 0 && !err)
+			err = res;
+		else if (res > 0)
+			changes += res;
+	}
+	closedir(dir);
+
+	return err ? err : changes;
+}
+
+/* Apply one uevent, made of '\0' separated fields. *list is the chips list
+   the changes go to, NULL until the first one. Returns the number of chips
+   added or removed, or <0 on error. */
+static int sensors_process_uevent(sensors_ctx *ctx, sensors_chip_list **list,
+				  const char *buf, size_t len)
+{
+	const char *p, *end = buf + len;
+	const char *action = NULL, *devpath = NULL, *subsystem = NULL;
+	const char *name;
+	int removed, res;
+
+	/* The first field is a summary, action@devpath */
+	for (p = buf + strnlen(buf, len) + 1; p < end;
+	     p += strnlen(p, end - p) + 1) {
+		if (!strncmp(p, "ACTION=", 7))
+			action = p + 7;
+		else if (!strncmp(p, "DEVPATH=", 8))
+			devpath = p + 8;
+		else if (!strncmp(p, "SUBSYSTEM=", 10))
+			subsystem = p + 10;
+	}
+	if (!action || !devpath || !subsystem ||
+	    strcmp(subsystem, "hwmon") || !(name = strrchr(devpath, '/')))
+		return 0;
+	name++;
+
+	if (strcmp(action, "remove") && strcmp(action, "add"))
+		return 0;
+	if (!*list)
+		*list = sensors_begin_changes(ctx);
+
+	/* If added, a device we already know about was recreated */
+	removed = sensors_remove_chip(ctx, *list, name);
+	if (!strcmp(action, "remove"))
+		return removed;
+
+	/* The new chip is loaded when first needed */
+	res = sensors_read_sysfs_chip(ctx, *list, name);
+	return res < 0 ? res : removed + res;
+}
+
+int sensors_process_uevents(sensors_ctx *ctx, sensors_uevent_source next,
+			    void *data)
+{
+	char buf[UEVENT_MAX];
+	sensors_chip_list *list = NULL;
+	ssize_t len;
+	int res, changes = 0, err = 0, lost = 0;
+
+	pthread_mutex_lock(&ctx->hotplug_lock);
+	while ((len = next(data, buf, sizeof(buf) - 1))) {
+		if (len == -ENOBUFS) {
+			lost = 1;
+			continue;
+		}
+		if (len < 0) {
+			err = -SENSORS_ERR_KERNEL;
+			break;
+		}
+
+		buf[len] = '\0';
+		res = sensors_process_uevent(ctx, &list, buf, len);
+		if (res < 0 && !err)
+			err = res;
+		else if (res > 0)
+			changes += res;
+	}
+
+	/* The events received are stale too then, but they were applied to
+	   the copy of the list we are about to read again */
+	if (lost && !err) {
+		if (!list)
+			list = sensors_begin_changes(ctx);
+		res = sensors_rescan_chips(ctx, list);
+		if (res < 0)
+			err = res;
+		else
+			changes += res;
+	}
+
+	if (changes) {
+		sensors_index_proc_chips(list);
+		__atomic_store_n(&ctx->proc_chips, list - ctx->chip_lists,
+				 __ATOMIC_RELEASE);
+		__atomic_add_fetch(&ctx->chips_generation, 1,
+				   __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&ctx->hotplug_lock);
+	return err ? err : changes;
+}
+
+/* Receive the next uevent from the socket *data */
+static ssize_t sensors_recv_uevent(void *data, char *buf, size_t size)
+{
+	int fd = *(int *)data;
+	struct sockaddr_nl addr;
+	struct iovec iov = { buf, size };
+	struct msghdr msg;
+	ssize_t len;
+
+	for (;;) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &addr;
+		msg.msg_namelen = sizeof(addr);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+
+		len = recvmsg(fd, &msg, MSG_DONTWAIT);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -errno;
+		}
+		if (len == 0)
+			return 0;
+
+		/* Only trust netlink messages sent by the kernel */
+		if (msg.msg_namelen == sizeof(addr) &&
+		    addr.nl_family == AF_NETLINK && addr.nl_pid == 0)
+			return len;
+	}
+}
+
+/* Callers must not hold a pin, see sensors_synchronize() */
+int sensors_ctx_hotplug_process(sensors_ctx *ctx, int fd)
+{
+	return sensors_process_uevents(ctx, sensors_recv_uevent, &fd);
+}
+
+int sensors_hotplug_process(int fd)
+{
+	sensors_ctx *ctx;
+	int res;
+
+	/* Changing the chips list of a generation which sensors_reload()
+	   is replacing would be lost */
+	ctx = sensors_lock_default_ctx();
+	res = sensors_ctx_hotplug_process(ctx, fd);
+	sensors_unlock_default_ctx();
+	return res;
+}
+
+unsigned int sensors_ctx_get_chips_generation(sensors_ctx *ctx)
+{
+	return __atomic_load_n(&ctx->chips_generation, __ATOMIC_ACQUIRE);
+}
+
+unsigned int sensors_get_chips_generation(void)
+{
+	sensors_ctx *ctx;
+	unsigned int res;
+	int pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_ctx_get_chips_generation(ctx);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
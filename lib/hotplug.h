@@ -0,0 +1,39 @@
+/*
+    hotplug.h - Part of libsensors, a Linux library for reading sensor data.
+    Copyright (C) 2026        The lm-sensors developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#ifndef LIB_SENSORS_HOTPLUG_H
+#define LIB_SENSORS_HOTPLUG_H
+
+#include <sys/types.h>
+#include "data.h"
+
+/* Copy the next pending uevent, made of '\0' separated fields, to buf.
+   Returns its length, 0 if there are none left, -ENOBUFS if some were
+   lost, or another negative errno value on failure. */
+typedef ssize_t (*sensors_uevent_source)(void *data, char *buf, size_t size);
+
+/* Apply the uevents read from next to the chips list of ctx, and publish
+   the result. If events were lost, all the chips are read again. Returns
+   the number of chips added or removed, or <0 on error. Callers must not
+   hold a pin, see sensors_synchronize(). */
+int sensors_process_uevents(sensors_ctx *ctx, sensors_uevent_source next,
+			    void *data);
+
+#endif /* def LIB_SENSORS_HOTPLUG_H */
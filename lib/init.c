@@ -19,8 +19,8 @@
     MA 02110-1301 USA.
 */
 
-/* Needed for scandir() and alphasort() */
-#define _BSD_SOURCE
+/* Needed for scandir(), alphasort() and sched_getcpu() */
+#define _GNU_SOURCE
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -31,6 +31,8 @@
 #include <errno.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 #include "sensors.h"
 #include "data.h"
 #include "error.h"
@@ -38,12 +40,16 @@
 #include "conf.h"
 #include "sysfs.h"
 #include "scanner.h"
+#include "cache.h"
 #include "init.h"
 
 #define DEFAULT_CONFIG_FILE	ETCDIR "/sensors3.conf"
 #define ALT_CONFIG_FILE		ETCDIR "/sensors.conf"
 #define DEFAULT_CONFIG_DIR	ETCDIR "/sensors.d"
 
+/* The configuration parser isn't reentrant */
+static pthread_mutex_t sensors_parse_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /* Wrapper around sensors_yyparse(), which clears the locale so that
    the decimal numbers are always parsed properly. */
 static int sensors_parse(void)
@@ -77,18 +83,18 @@ static void free_bus(sensors_bus *bus)
 	free(bus->adapter);
 }
 
-static void free_config_busses(void)
+static void free_config_busses(sensors_ctx *ctx)
 {
 	int i;
 
-	for (i = 0; i < sensors_config_busses_count; i++)
-		free_bus(&sensors_config_busses[i]);
-	free(sensors_config_busses);
-	sensors_config_busses = NULL;
-	sensors_config_busses_count = sensors_config_busses_max = 0;
+	for (i = 0; i < ctx->config_busses_count; i++)
+		free_bus(&ctx->config_busses[i]);
+	free(ctx->config_busses);
+	ctx->config_busses = NULL;
+	ctx->config_busses_count = ctx->config_busses_max = 0;
 }
 
-static int parse_config(FILE *input, const char *name)
+static int parse_config(sensors_ctx *ctx, FILE *input, const char *name)
 {
 	int err;
 	char *name_copy;
@@ -98,25 +104,29 @@ static int parse_config(FILE *input, const char *name)
 		name_copy = strdup(name);
 		if (!name_copy)
 			sensors_fatal_error(__func__, "Out of memory");
-		sensors_add_config_files(&name_copy);
+		sensors_add_config_files(ctx, &name_copy);
 	} else
 		name_copy = NULL;
 
+	pthread_mutex_lock(&sensors_parse_lock);
+	sensors_parse_ctx = ctx;
 	if (sensors_scanner_init(input, name_copy)) {
 		err = -SENSORS_ERR_PARSE;
-		goto exit_cleanup;
+		goto exit_unlock;
 	}
 	err = sensors_parse();
 	sensors_scanner_exit();
+exit_unlock:
+	pthread_mutex_unlock(&sensors_parse_lock);
 	if (err) {
 		err = -SENSORS_ERR_PARSE;
 		goto exit_cleanup;
 	}
 
-	err = sensors_substitute_busses();
+	err = sensors_substitute_busses(ctx);
 
 exit_cleanup:
-	free_config_busses();
+	free_config_busses(ctx);
 	return err;
 }
 
@@ -125,7 +135,7 @@ static int config_file_filter(const struct dirent *entry)
 	return entry->d_name[0] != '.';		/* Skip hidden files */
 }
 
-static int add_config_from_dir(const char *dir)
+static int add_config_from_dir(sensors_ctx *ctx, const char *dir)
 {
 	int count, res, i;
 	struct dirent **namelist;
@@ -159,7 +169,7 @@ static int add_config_from_dir(const char *dir)
 
 		input = fopen(path, "r");
 		if (input) {
-			res = parse_config(input, path);
+			res = parse_config(ctx, input, path);
 			fclose(input);
 		} else {
 			res = -SENSORS_ERR_PARSE;
@@ -175,23 +185,113 @@ static int add_config_from_dir(const char *dir)
 	return res;
 }
 
+/* Free the detected chips and i2c adapters lists */
+static void free_proc_data(sensors_ctx *ctx)
+{
+	sensors_chip_list *list = sensors_proc_chips(ctx);
+	int i;
+
+	for (i = 0; i < list->count; i++) {
+		sensors_close_sysfs_attrs(list->chip[i]);
+		sensors_free_proc_chip(list->chip[i]);
+	}
+	/* Their attribute files were closed when they were removed */
+	for (i = 0; i < ctx->removed_chips_count; i++)
+		sensors_free_proc_chip(ctx->removed_chips[i]);
+	free(ctx->removed_chips);
+	ctx->removed_chips = NULL;
+	ctx->removed_chips_count = ctx->removed_chips_max = 0;
+
+	for (i = 0; i < 2; i++) {
+		list = &ctx->chip_lists[i];
+		free(list->chip);
+		free(list->index);
+		memset(list, 0, sizeof(*list));
+	}
+	ctx->proc_chips = 0;
+
+	sensors_free_sysfs_attrs(&ctx->fd_cache);
+
+	for (i = 0; i < ctx->proc_bus_count; i++)
+		free_bus(&ctx->proc_bus[i]);
+	free(ctx->proc_bus);
+	ctx->proc_bus = NULL;
+	ctx->proc_bus_count = ctx->proc_bus_max = 0;
+}
+
+/* Only keep the detected chips the application asked for */
+static void filter_proc_chips(sensors_ctx *ctx)
+{
+	sensors_chip_list *list = sensors_proc_chips(ctx);
+	int i, j;
+
+	for (i = j = 0; i < list->count; i++) {
+		if (sensors_chip_wanted(ctx, &list->chip[i]->chip))
+			list->chip[j++] = list->chip[i];
+		else
+			sensors_free_proc_chip(list->chip[i]);
+	}
+	list->count = j;
+}
+
+/* Keep a copy of the options, as sensors_reload() needs them again */
+static void set_options(sensors_ctx *ctx, int flags,
+			const sensors_chip_name *match, int match_count)
+{
+	int i;
+
+	ctx->flags = flags;
+	if (!match || match_count <= 0)
+		return;
+
+	ctx->match = malloc(match_count * sizeof(sensors_chip_name));
+	if (!ctx->match)
+		sensors_fatal_error(__func__, "Out of memory");
+	for (i = 0; i < match_count; i++) {
+		ctx->match[i] = match[i];
+		ctx->match[i].path = NULL;
+		if (match[i].prefix != SENSORS_CHIP_NAME_PREFIX_ANY &&
+		    !(ctx->match[i].prefix = strdup(match[i].prefix)))
+			sensors_fatal_error(__func__, "Out of memory");
+	}
+	ctx->match_count = match_count;
+}
+
+static void sensors_cleanup_ctx(sensors_ctx *ctx);
+
 /* Ideally, initialization and configuraton file loading should be exposed
    separately, to make it possible to load several configuration files. */
-int sensors_init(FILE *input)
+static int sensors_init_ctx(sensors_ctx *ctx, FILE *input, int flags,
+			    const sensors_chip_name *match, int match_count)
 {
 	int res;
 
-	if (!sensors_init_sysfs())
-		return -SENSORS_ERR_KERNEL;
-	if ((res = sensors_read_sysfs_bus()) ||
-	    (res = sensors_read_sysfs_chips()))
+	set_options(ctx, flags, match, match_count);
+
+	if (!sensors_init_sysfs()) {
+		res = -SENSORS_ERR_KERNEL;
 		goto exit_cleanup;
+	}
+	if (sensors_read_cache(ctx)) {
+		free_proc_data(ctx);
+		if ((!(flags & SENSORS_INIT_NO_BUS) &&
+		     (res = sensors_read_sysfs_bus(ctx))) ||
+		    (res = sensors_read_sysfs_chips(ctx)))
+			goto exit_cleanup;
+		/* The cache is only useful if complete. It is written once
+		   all the chips are loaded, see sensors_load_chips(). */
+		if ((flags & SENSORS_INIT_NO_BUS) || ctx->match)
+			sensors_free_cache_key(ctx);
+	} else if (ctx->match) {
+		filter_proc_chips(ctx);
+	}
+	sensors_index_proc_chips(sensors_proc_chips(ctx));
 
 	if (input) {
-		res = parse_config(input, NULL);
+		res = parse_config(ctx, input, NULL);
 		if (res)
 			goto exit_cleanup;
-	} else {
+	} else if (!(flags & SENSORS_INIT_NO_CONFIG)) {
 		const char* name;
 
 		/* No configuration provided, use default */
@@ -199,7 +299,7 @@ int sensors_init(FILE *input)
 		if (!input && errno == ENOENT)
 			input = fopen(name = ALT_CONFIG_FILE, "r");
 		if (input) {
-			res = parse_config(input, name);
+			res = parse_config(ctx, input, name);
 			fclose(input);
 			if (res)
 				goto exit_cleanup;
@@ -211,34 +311,75 @@ int sensors_init(FILE *input)
 		}
 
 		/* Also check for files in default directory */
-		res = add_config_from_dir(DEFAULT_CONFIG_DIR);
+		res = add_config_from_dir(ctx, DEFAULT_CONFIG_DIR);
 		if (res)
 			goto exit_cleanup;
 	}
 
+	sensors_resolve_config(ctx);
 	return 0;
 
 exit_cleanup:
-	sensors_cleanup();
+	sensors_cleanup_ctx(ctx);
 	return res;
 }
 
-static void free_chip_name(sensors_chip_name *name)
+int sensors_init(FILE *input)
 {
-	free(name->prefix);
-	free(name->path);
+	return sensors_init_ex(input, 0, NULL, 0);
 }
 
-static void free_chip_features(sensors_chip_features *features)
+int sensors_init_ex(FILE *input, int flags, const sensors_chip_name *match,
+		    int match_count)
 {
-	int i;
+	return sensors_init_ctx(&sensors_default_ctx, input, flags, match,
+				match_count);
+}
+
+int sensors_ctx_init(sensors_ctx **ctx, FILE *input)
+{
+	return sensors_ctx_init_ex(ctx, input, 0, NULL, 0);
+}
+
+static sensors_ctx *sensors_alloc_ctx(void)
+{
+	sensors_ctx *ctx;
+	void *p = NULL;
+
+	/* Aligned for the pin counters */
+	if (posix_memalign(&p, __alignof__(sensors_ctx), sizeof(sensors_ctx)))
+		sensors_fatal_error(__func__, "Out of memory");
+	ctx = memset(p, 0, sizeof(sensors_ctx));
+	pthread_mutex_init(&ctx->ctx_pins.sync_lock, NULL);
+	ctx->pins = &ctx->ctx_pins;
+	pthread_mutex_init(&ctx->label_lock, NULL);
+	pthread_mutex_init(&ctx->load_lock, NULL);
+	pthread_mutex_init(&ctx->hotplug_lock, NULL);
+	pthread_mutex_init(&ctx->fd_cache.lock, NULL);
+	return ctx;
+}
+
+int sensors_ctx_init_ex(sensors_ctx **ctx, FILE *input, int flags,
+			const sensors_chip_name *match, int match_count)
+{
+	sensors_ctx *new_ctx;
+	int res;
+
+	new_ctx = sensors_alloc_ctx();
+	if ((res = sensors_init_ctx(new_ctx, input, flags, match,
+				    match_count))) {
+		sensors_ctx_free(new_ctx);
+		return res;
+	}
+
+	*ctx = new_ctx;
+	return 0;
+}
 
-	for (i = 0; i < features->subfeature_count; i++)
-		free(features->subfeature[i].name);
-	free(features->subfeature);
-	for (i = 0; i < features->feature_count; i++)
-		free(features->feature[i].name);
-	free(features->feature);
+static void free_chip_name(sensors_chip_name *name)
+{
+	free(name->prefix);
+	free(name->path);
 }
 
 static void free_label(sensors_label *label)
@@ -308,34 +449,210 @@ static void free_chip(sensors_chip *chip)
 	chip->ignores_count = chip->ignores_max = 0;
 }
 
-void sensors_cleanup(void)
+static void sensors_cleanup_ctx(sensors_ctx *ctx)
 {
 	int i;
 
-	for (i = 0; i < sensors_proc_chips_count; i++) {
-		free_chip_name(&sensors_proc_chips[i].chip);
-		free_chip_features(&sensors_proc_chips[i]);
+	free_proc_data(ctx);
+	sensors_free_cache_key(ctx);
+
+	for (i = 0; i < ctx->match_count; i++)
+		free_chip_name(&ctx->match[i]);
+	free(ctx->match);
+	ctx->match = NULL;
+	ctx->match_count = 0;
+	ctx->flags = 0;
+	ctx->cache_time = 0;
+
+	for (i = 0; i < ctx->config_chips_count; i++)
+		free_chip(&ctx->config_chips[i]);
+	free(ctx->config_chips);
+	ctx->config_chips = NULL;
+	ctx->config_chips_count = ctx->config_chips_max = 0;
+	ctx->config_chips_subst = 0;
+	ctx->resolved = 0;
+
+	for (i = 0; i < ctx->config_files_count; i++)
+		free(ctx->config_files[i]);
+	free(ctx->config_files);
+	ctx->config_files = NULL;
+	ctx->config_files_count = ctx->config_files_max = 0;
+}
+
+void sensors_ctx_free(sensors_ctx *ctx)
+{
+	sensors_cleanup_ctx(ctx);
+	pthread_mutex_destroy(&ctx->label_lock);
+	pthread_mutex_destroy(&ctx->load_lock);
+	pthread_mutex_destroy(&ctx->hotplug_lock);
+	pthread_mutex_destroy(&ctx->fd_cache.lock);
+	pthread_mutex_destroy(&ctx->ctx_pins.sync_lock);
+	free(ctx);
+}
+
+/*
+ * Pins keep what a call is reading from being freed under it, without any
+ * lock on the read paths. A pin is a count of the calls in progress on a
+ * context, in one of two slots, and in the shard of the CPU the call
+ * started on. Writers which free memory first make it unreachable, then
+ * wait for the calls which could still reach it: they switch the slot new
+ * calls use, wait for the calls of the other slot to return, and do it
+ * again for the other slot, so that a steady flow of new calls can't keep
+ * them waiting forever. Only the calls on the context being changed are
+ * waited for.
+ */
+int sensors_pin(sensors_pins *pins)
+{
+	int cpu, pin;
+
+	/* Any shard works, as long as the call unpins the same one */
+	cpu = sched_getcpu();
+	pin = (cpu < 0 ? 0 : cpu % SENSORS_PIN_SHARDS) << 1 |
+	      (__atomic_load_n(&pins->epoch, __ATOMIC_RELAXED) & 1);
+	__atomic_add_fetch(&pins->shard[pin >> 1].count[pin & 1], 1,
+			   __ATOMIC_SEQ_CST);
+	return pin;
+}
+
+void sensors_unpin(sensors_pins *pins, int pin)
+{
+	__atomic_sub_fetch(&pins->shard[pin >> 1].count[pin & 1], 1,
+			   __ATOMIC_RELEASE);
+}
+
+/* Writers call this with sensors_gen_lock or the hotplug lock of the
+   context held, which only keeps the other writers of the context
+   waiting: readers never take these locks. As calls only hold their pin
+   while they run, and never while waiting for events, the wait is short,
+   and yielding the CPU is enough. */
+void sensors_synchronize(sensors_pins *pins)
+{
+	int i, j, slot;
+
+	pthread_mutex_lock(&pins->sync_lock);
+	for (i = 0; i < 2; i++) {
+		slot = __atomic_fetch_add(&pins->epoch, 1,
+					  __ATOMIC_SEQ_CST) & 1;
+		for (j = 0; j < SENSORS_PIN_SHARDS; j++)
+			while (__atomic_load_n(&pins->shard[j].count[slot],
+					       __ATOMIC_SEQ_CST))
+				sched_yield();
 	}
-	free(sensors_proc_chips);
-	sensors_proc_chips = NULL;
-	sensors_proc_chips_count = sensors_proc_chips_max = 0;
-
-	for (i = 0; i < sensors_config_chips_count; i++)
-		free_chip(&sensors_config_chips[i]);
-	free(sensors_config_chips);
-	sensors_config_chips = NULL;
-	sensors_config_chips_count = sensors_config_chips_max = 0;
-	sensors_config_chips_subst = 0;
-
-	for (i = 0; i < sensors_proc_bus_count; i++)
-		free_bus(&sensors_proc_bus[i]);
-	free(sensors_proc_bus);
-	sensors_proc_bus = NULL;
-	sensors_proc_bus_count = sensors_proc_bus_max = 0;
-
-	for (i = 0; i < sensors_config_files_count; i++)
-		free(sensors_config_files[i]);
-	free(sensors_config_files);
-	sensors_config_files = NULL;
-	sensors_config_files_count = sensors_config_files_max = 0;
+	pthread_mutex_unlock(&pins->sync_lock);
+}
+
+/* The original API works on the current generation of the default
+   context, which sensors_reload() replaces as a whole. The previous
+   generation is kept until the next reload, so that the pointers the
+   application got from it remain valid meanwhile, and is then freed once
+   no call can be reading it anymore. The first generation is
+   sensors_default_ctx itself. Writers are serialized by sensors_gen_lock,
+   readers only pin the generation.
+
+   Plans, watches and handles reach the chips of a generation through its
+   handles, which outlive the generation as long as they are referenced.
+   Before a generation is freed, its handles are detached from their chip,
+   as when a chip is removed, and calls through them fail with
+   -SENSORS_ERR_NO_ENTRY. */
+static pthread_mutex_t sensors_gen_lock = PTHREAD_MUTEX_INITIALIZER;
+static sensors_ctx *sensors_current_gen = &sensors_default_ctx;
+static sensors_ctx *sensors_previous_gen;
+
+/* Detach the handles of a generation from its chips, and keep its chips
+   from being loaded, before it is freed */
+static void sensors_retire_gen(sensors_ctx *ctx)
+{
+	const sensors_chip_list *list = sensors_proc_chips(ctx);
+	int i;
+
+	pthread_mutex_lock(&ctx->load_lock);
+	for (i = 0; i < list->count; i++) {
+		list->chip[i]->removed = 1;
+		if (list->chip[i]->handle)
+			__atomic_store_n(&list->chip[i]->handle->chip, NULL,
+					 __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&ctx->load_lock);
+}
+
+static void sensors_free_gen(sensors_ctx *ctx)
+{
+	if (ctx == &sensors_default_ctx)
+		sensors_cleanup_ctx(ctx);	/* ready for sensors_init() */
+	else
+		sensors_ctx_free(ctx);
+}
+
+sensors_ctx *sensors_pin_default_ctx(int *pin)
+{
+	*pin = sensors_pin(&sensors_default_pins);
+	return __atomic_load_n(&sensors_current_gen, __ATOMIC_ACQUIRE);
+}
+
+sensors_ctx *sensors_lock_default_ctx(void)
+{
+	pthread_mutex_lock(&sensors_gen_lock);
+	return sensors_current_gen;
+}
+
+void sensors_unlock_default_ctx(void)
+{
+	pthread_mutex_unlock(&sensors_gen_lock);
+}
+
+int sensors_reload(FILE *input)
+{
+	sensors_ctx *ctx, *current, *retired;
+	int res, cache_time, pin;
+
+	/* With the same options as the current generation. On failure, the
+	   current generation remains in use. */
+	ctx = sensors_alloc_ctx();
+	ctx->pins = &sensors_default_pins;
+	current = sensors_pin_default_ctx(&pin);
+	res = sensors_init_ctx(ctx, input, current->flags, current->match,
+			       current->match_count);
+	cache_time = current->cache_time;
+	sensors_unpin(current->pins, pin);
+	if (res) {
+		sensors_ctx_free(ctx);
+		return res;
+	}
+	sensors_ctx_set_cache_time(ctx, cache_time);
+
+	pthread_mutex_lock(&sensors_gen_lock);
+	ctx->chips_generation = sensors_current_gen->chips_generation + 1;
+	retired = sensors_previous_gen;
+	sensors_previous_gen = sensors_current_gen;
+	__atomic_store_n(&sensors_current_gen, ctx, __ATOMIC_RELEASE);
+
+	/* Calls which got the retired generation before the previous reload,
+	   or which go through its handles, may still be reading it */
+	if (retired) {
+		sensors_retire_gen(retired);
+		sensors_synchronize(&sensors_default_pins);
+		sensors_free_gen(retired);
+	}
+	pthread_mutex_unlock(&sensors_gen_lock);
+	return 0;
+}
+
+void sensors_cleanup(void)
+{
+	sensors_ctx *current, *previous;
+
+	pthread_mutex_lock(&sensors_gen_lock);
+	current = sensors_current_gen;
+	previous = sensors_previous_gen;
+	sensors_previous_gen = NULL;
+	__atomic_store_n(&sensors_current_gen, &sensors_default_ctx,
+			 __ATOMIC_RELEASE);
+
+	/* Let the calls in progress complete before freeing what they may
+	   be reading */
+	sensors_synchronize(&sensors_default_pins);
+	if (previous)
+		sensors_free_gen(previous);
+	sensors_free_gen(current);
+	pthread_mutex_unlock(&sensors_gen_lock);
 }
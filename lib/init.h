@@ -25,4 +25,23 @@
 
 void sensors_free_expr(sensors_expr *expr);
 
+/* Pin what the calls read, see init.c. Each call to sensors_pin() must
+   be matched by a call to sensors_unpin() with the same pins and the pin
+   it returned, and calls holding a pin must not call sensors_synchronize(),
+   which waits until all the pins of pins taken before it are released. */
+int sensors_pin(sensors_pins *pins);
+void sensors_unpin(sensors_pins *pins, int pin);
+void sensors_synchronize(sensors_pins *pins);
+
+/* Return the current generation of the default context. It is pinned, so
+   that a concurrent sensors_reload() doesn't free it before the matching
+   call to sensors_unpin() with its pins. */
+sensors_ctx *sensors_pin_default_ctx(int *pin);
+
+/* Return the current generation of the default context, and keep
+   sensors_reload() from replacing it until the matching call to
+   sensors_unlock_default_ctx(). For writers, which can't hold a pin. */
+sensors_ctx *sensors_lock_default_ctx(void);
+void sensors_unlock_default_ctx(void);
+
 #endif /* def LIB_SENSORS_INIT_H */
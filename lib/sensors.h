@@ -75,10 +75,78 @@ typedef struct sensors_chip_name {
    calling sensors_init() again. */
 int sensors_init(FILE *input);
 
+/* Flags of sensors_init_ex() */
+#define SENSORS_INIT_NO_BUS	0x01	/* don't read the i2c adapter names */
+#define SENSORS_INIT_NO_CONFIG	0x02	/* no default configuration files */
+
+/* Same as sensors_init(), with options for applications which need a
+   fast start-up. With SENSORS_INIT_NO_BUS, the i2c adapter names aren't
+   read, so sensors_get_adapter_name() doesn't know them, and chip
+   statements with a bus number in the configuration are ignored. With
+   SENSORS_INIT_NO_CONFIG, no configuration file is loaded if input is
+   NULL. If match_count is not 0, only the chips which match one of the
+   match_count chip names match[] are detected; the others are ignored
+   as soon as their name is known. */
+int sensors_init_ex(FILE *input, int flags, const sensors_chip_name *match,
+		    int match_count);
+
 /* Clean-up function: You can't access anything after
    this, until the next sensors_init() call! */
 void sensors_cleanup(void);
 
+/* Load the configuration file and the detected chips list again, while
+   other threads keep reading values. The new configuration and chips list
+   are built aside, then replace the current ones at once. The previous
+   ones are freed by the next reload: until then, the chip names, features
+   and labels obtained from them remain valid, and the plans, watches and
+   handles keep working. After that, plans and handles fail with
+   -SENSORS_ERR_NO_ENTRY and watches no longer report alarms, so
+   applications should enumerate the chips, and create their plans, watches
+   and handles, again after each reload. If this returns a value unequal
+   to zero, the current configuration and chips list are kept. The options
+   given to sensors_init_ex(), if any, still apply. */
+int sensors_reload(FILE *input);
+
+/* Open a socket on which the kernel reports hwmon devices being added or
+   removed. When it is readable, call sensors_hotplug_process(). This
+   function will return the socket on success, and <0 on failure. Close
+   it when done. */
+int sensors_hotplug_open(void);
+
+/* Read the pending events from the socket fd, and add or remove the
+   chips they are about. Other threads may keep using the library
+   meanwhile. The chip names of the chips which were removed remain valid
+   until the next call, and the positions of the other chips in the list
+   may change, so enumerate the chips again if anything changed. If the
+   kernel reports that events were lost, all the chips are read again, and
+   their handles are no longer valid. This function will return the
+   number of chips added or removed, and <0 on failure. */
+int sensors_hotplug_process(int fd);
+
+/* Return a number which changes whenever the detected chips list changes,
+   be it through sensors_reload() or sensors_hotplug_process(). */
+unsigned int sensors_get_chips_generation(void);
+
+/* A context holds a configuration and a detected chips list, independently
+   of sensors_init(). The functions of this API work on a default context;
+   the sensors_ctx_* functions below are the same, but work on the given
+   context instead. */
+typedef struct sensors_ctx sensors_ctx;
+
+/* Create a context and load the configuration file and the detected chips
+   list into it, as sensors_init() does. Contexts are independent of each
+   other, and a context can be read from several threads at once. This
+   function will return 0 on success, and <0 on failure. */
+int sensors_ctx_init(sensors_ctx **ctx, FILE *input);
+
+/* Same as sensors_ctx_init(), with the options of sensors_init_ex() */
+int sensors_ctx_init_ex(sensors_ctx **ctx, FILE *input, int flags,
+			const sensors_chip_name *match, int match_count);
+
+/* Free a context. You can't access anything obtained through it after
+   this, except to free the plans, watches and handles. */
+void sensors_ctx_free(sensors_ctx *ctx);
+
 /* Parse a chip name to the internal representation. Return 0 on success, <0
    on error. */
 int sensors_parse_chip_name(const char *orig_name, sensors_chip_name *res);
@@ -106,12 +174,101 @@ typedef struct sensors_feature sensors_feature;
 char *sensors_get_label(const sensors_chip_name *name,
 			const sensors_feature *feature);
 
+/* Same as sensors_get_label(), but the returned string belongs to the
+   library and remains valid as long as the chip name, see sensors_reload()
+   and sensors_hotplug_process(). The labels of a chip are all looked up
+   the first time one of them is needed, so subsequent calls don't
+   allocate memory nor access sysfs. */
+const char *sensors_get_label_ref(const sensors_chip_name *name,
+				  const sensors_feature *feature);
+
 /* Read the value of a subfeature of a certain chip. Note that chip should not
    contain wildcard values! This function will return 0 on success, and <0
    on failure.  */
 int sensors_get_value(const sensors_chip_name *name, int subfeat_nr,
 		      double *value);
 
+/* Read the values of several subfeatures of a certain chip at once. Note
+   that chip should not contain wildcard values! The value of subfeature
+   subfeat_nrs[i] is stored in values[i]. If errors is not NULL, errors[i]
+   is set to 0 if that value could be read, and <0 otherwise. This function
+   will return 0 if all values could be read, and <0 on failure. */
+int sensors_get_values(const sensors_chip_name *name, const int *subfeat_nrs,
+		       int count, double *values, int *errors);
+
+/* A value as the kernel exports it: an integer, in units of 1/scale of
+   the unit of the subfeature, for example millidegrees Celsius (scale
+   1000) for a temperature, or microjoules (scale 1000000) for energy. */
+typedef struct sensors_raw_value {
+	long long value;
+	int scale;
+} sensors_raw_value;
+
+/* Same as sensors_get_value() and sensors_get_values(), but return the
+   values as the kernel exports them, without converting them to floating
+   point. Compute statements are not applied. Attributes which don't hold
+   an integer in the range of long long fail with -SENSORS_ERR_ACCESS_R. */
+int sensors_get_raw_value(const sensors_chip_name *name, int subfeat_nr,
+			  sensors_raw_value *value);
+int sensors_get_raw_values(const sensors_chip_name *name,
+			   const int *subfeat_nrs, int count,
+			   sensors_raw_value *values, int *errors);
+
+/* A value with the times it was read at: the read of the attribute
+   started at start and ended at end, in ns of CLOCK_MONOTONIC. Values
+   served from the cache (see sensors_set_cache_time()) come with the times
+   of the read they were cached from. */
+typedef struct sensors_timed_value {
+	double value;
+	long long start;
+	long long end;
+} sensors_timed_value;
+
+/* Same as sensors_get_value() and sensors_get_values(), but also return
+   when each value was read, and so how long each read took */
+int sensors_get_timed_value(const sensors_chip_name *name, int subfeat_nr,
+			    sensors_timed_value *value);
+int sensors_get_timed_values(const sensors_chip_name *name,
+			     const int *subfeat_nrs, int count,
+			     sensors_timed_value *values, int *errors);
+
+/* A sampling plan is an opaque, pre-resolved list of subfeatures, for
+   applications which read the same values over and over again. */
+typedef struct sensors_plan sensors_plan;
+
+/* Create a sampling plan for subfeatures subfeat_nrs[i] of chips names[i].
+   Note that the chips should not contain wildcard values! The plan can be
+   executed until the next call to sensors_cleanup(), and must be freed
+   with sensors_free_plan(). The values of the chips removed by
+   sensors_hotplug_process() or freed by sensors_reload() since then fail
+   with -SENSORS_ERR_NO_ENTRY. A plan holds the buffer its executions read
+   the values to, so it can't be executed by several threads at once;
+   create one plan per thread. This function will return 0 on success, and
+   <0 on failure. */
+int sensors_create_plan(const sensors_chip_name * const *names,
+			const int *subfeat_nrs, int count,
+			sensors_plan **plan);
+
+/* Read all the values of a sampling plan, in the order they were given
+   when the plan was created. If errors is not NULL, errors[i] is set to 0
+   if values[i] could be read, and <0 otherwise. This function will return
+   0 if all values could be read, and <0 on failure. */
+int sensors_execute_plan(const sensors_plan *plan, double *values,
+			 int *errors);
+
+/* Same as sensors_execute_plan(), but return the values as the kernel
+   exports them, as sensors_get_raw_values() does */
+int sensors_execute_plan_raw(const sensors_plan *plan,
+			     sensors_raw_value *values, int *errors);
+
+/* Same as sensors_execute_plan(), but also return when each value was
+   read, as sensors_get_timed_values() does */
+int sensors_execute_plan_timed(const sensors_plan *plan,
+			       sensors_timed_value *values, int *errors);
+
+/* Free a sampling plan. */
+void sensors_free_plan(sensors_plan *plan);
+
 /* Set the value of a subfeature of a certain chip. Note that chip should not
    contain wildcard values! This function will return 0 on success, and <0
    on failure. */
@@ -122,6 +279,20 @@ int sensors_set_value(const sensors_chip_name *name, int subfeat_nr,
    wildcards!  This function will return 0 on success, and <0 on failure. */
 int sensors_do_chip_sets(const sensors_chip_name *name);
 
+/* Values read from a chip are served again, without reading the chip,
+   until they are older than the update interval of the chip. Set the
+   minimum time, in ms, they are cached for, or 0 (the default) to only
+   follow the update interval of each chip. */
+void sensors_set_cache_time(int ms);
+
+/* Limits and other settings read from a chip are served again for 10
+   times as long as measurements, and at least 1 s, unless written through
+   sensors_set_value() or sensors_do_chip_sets(), or chips are hotplugged,
+   or the system resumes. Drop all the cached values of the chips matching
+   match, or of all chips if match is NULL, for when settings were just
+   changed by someone else. The chip may contain wildcards! */
+void sensors_flush_values(const sensors_chip_name *match);
+
 /* This function returns all detected chips that match a given chip name,
    one by one. If no chip name is provided, all detected chips are returned.
    To start at the beginning of the list, use 0 for nr; NULL is returned if
@@ -291,6 +462,13 @@ typedef struct sensors_subfeature {
 const sensors_feature *
 sensors_get_features(const sensors_chip_name *name, int *nr);
 
+/* This returns all main features of a specific chip at once, as an array
+   of *count pointers, in the same order as sensors_get_features(). The
+   array belongs to the library and remains valid as long as the chip name,
+   see sensors_reload(). If the chip isn't found, NULL is returned. */
+const sensors_feature * const *
+sensors_get_feature_list(const sensors_chip_name *name, int *count);
+
 /* This returns all subfeatures of a given main feature. nr is an internally
    used variable. Set it to zero to start at the begin of the list. If no
    more features are found NULL is returned.
@@ -309,6 +487,156 @@ sensors_get_subfeature(const sensors_chip_name *name,
 		       const sensors_feature *feature,
 		       sensors_subfeature_type type);
 
+/* A watch is an opaque set of alarm subfeatures, for applications which
+   want to be notified when alarms change instead of reading them
+   periodically. Only drivers which call sysfs_notify() on their alarm
+   attributes notify changes; this is not the case of all drivers. */
+typedef struct sensors_watch sensors_watch;
+
+/* Create a watch on the alarm subfeatures of the chips which match one of
+   the match_count chip names match[], or of all the chips if match_count
+   is 0. The watch can be used until the next call to sensors_cleanup(),
+   and must be freed with sensors_free_watch(). This function will return
+   0 on success, and <0 on failure. */
+int sensors_create_watch(const sensors_chip_name *match, int match_count,
+			 sensors_watch **watch);
+
+/* Return a file descriptor which is readable when alarms changed, for use
+   with poll(), select() or epoll. Don't read from it nor close it, call
+   sensors_read_watch() instead. */
+int sensors_get_watch_fd(const sensors_watch *watch);
+
+/* Wait up to timeout milliseconds (-1 for no limit, 0 to not wait at all)
+   for an alarm to change, and return it in *name and *subfeature. Call it
+   until it returns 0 to get all the pending changes. This function will
+   return 1 if an alarm changed, 0 if none did in time or a signal was
+   received, and <0 on failure. The cached values of the chip of the alarm
+   are dropped, see sensors_flush_values(). The alarms of the chips
+   removed by sensors_hotplug_process() or freed by sensors_reload() are
+   no longer reported. */
+int sensors_read_watch(sensors_watch *watch, int timeout,
+		       const sensors_chip_name **name,
+		       const sensors_subfeature **subfeature);
+
+/* Free a watch. */
+void sensors_free_watch(sensors_watch *watch);
+
+/* Handles are opaque references to a detected chip and to one of its
+   subfeatures, for applications which access the same chips over and over
+   again. Everything needed to access them is resolved once, when they are
+   obtained, so the functions which take a handle don't look up anything.
+   Chip handles remain valid until freed with sensors_free_chip_handle(),
+   and subfeature handles as long as the chip handle they come from.
+   Unlike chip names, they also remain valid once their chip is removed by
+   sensors_hotplug_process() or freed by sensors_reload(), but the
+   functions which take them then fail. */
+typedef struct sensors_chip_handle sensors_chip_handle;
+typedef struct sensors_sf_handle sensors_sf_handle;
+
+/* Return the handle of a detected chip, or NULL if it isn't found. Note
+   that chip should not contain wildcard values! */
+const sensors_chip_handle *
+sensors_get_chip_handle(const sensors_chip_name *name);
+
+/* Free a chip handle, and the subfeature handles obtained from it */
+void sensors_free_chip_handle(const sensors_chip_handle *chip);
+
+/* Return the chip name of a chip handle, or NULL if the chip was removed
+   or freed since the handle was obtained */
+const sensors_chip_name *
+sensors_handle_get_name(const sensors_chip_handle *chip);
+
+/* Same as sensors_get_features(), sensors_get_all_subfeatures() and
+   sensors_get_subfeature(), taking a chip handle. These return NULL if the
+   chip was removed or freed since the handle was obtained. */
+const sensors_feature *
+sensors_handle_get_features(const sensors_chip_handle *chip, int *nr);
+const sensors_subfeature *
+sensors_handle_get_all_subfeatures(const sensors_chip_handle *chip,
+				   const sensors_feature *feature, int *nr);
+const sensors_subfeature *
+sensors_handle_get_subfeature(const sensors_chip_handle *chip,
+			      const sensors_feature *feature,
+			      sensors_subfeature_type type);
+
+/* Return the handle of subfeature subfeat_nr of a chip, or NULL if there
+   is no such subfeature */
+const sensors_sf_handle *
+sensors_get_sf_handle(const sensors_chip_handle *chip, int subfeat_nr);
+
+/* Same as sensors_get_value() and sensors_set_value(), taking a subfeature
+   handle. These return -SENSORS_ERR_NO_ENTRY if the chip was removed or
+   freed since the handle was obtained. */
+int sensors_handle_get_value(const sensors_sf_handle *sf, double *value);
+int sensors_handle_set_value(const sensors_sf_handle *sf, double value);
+
+/* Same as sensors_get_raw_value() and sensors_get_timed_value(), taking a
+   subfeature handle */
+int sensors_handle_get_raw_value(const sensors_sf_handle *sf,
+				 sensors_raw_value *value);
+int sensors_handle_get_timed_value(const sensors_sf_handle *sf,
+				   sensors_timed_value *value);
+
+/* Same as the functions above, but working on context ctx */
+const sensors_chip_name *
+sensors_ctx_get_detected_chips(sensors_ctx *ctx,
+			       const sensors_chip_name *match, int *nr);
+const char *sensors_ctx_get_adapter_name(sensors_ctx *ctx,
+					 const sensors_bus_id *bus);
+const sensors_feature *
+sensors_ctx_get_features(sensors_ctx *ctx, const sensors_chip_name *name,
+			 int *nr);
+const sensors_feature * const *
+sensors_ctx_get_feature_list(sensors_ctx *ctx, const sensors_chip_name *name,
+			     int *count);
+const sensors_subfeature *
+sensors_ctx_get_all_subfeatures(sensors_ctx *ctx,
+				const sensors_chip_name *name,
+				const sensors_feature *feature, int *nr);
+const sensors_subfeature *
+sensors_ctx_get_subfeature(sensors_ctx *ctx, const sensors_chip_name *name,
+			   const sensors_feature *feature,
+			   sensors_subfeature_type type);
+char *sensors_ctx_get_label(sensors_ctx *ctx, const sensors_chip_name *name,
+			    const sensors_feature *feature);
+const char *sensors_ctx_get_label_ref(sensors_ctx *ctx,
+				      const sensors_chip_name *name,
+				      const sensors_feature *feature);
+const sensors_chip_handle *
+sensors_ctx_get_chip_handle(sensors_ctx *ctx, const sensors_chip_name *name);
+int sensors_ctx_get_value(sensors_ctx *ctx, const sensors_chip_name *name,
+			  int subfeat_nr, double *value);
+int sensors_ctx_get_values(sensors_ctx *ctx, const sensors_chip_name *name,
+			   const int *subfeat_nrs, int count, double *values,
+			   int *errors);
+int sensors_ctx_get_raw_value(sensors_ctx *ctx, const sensors_chip_name *name,
+			      int subfeat_nr, sensors_raw_value *value);
+int sensors_ctx_get_raw_values(sensors_ctx *ctx, const sensors_chip_name *name,
+			       const int *subfeat_nrs, int count,
+			       sensors_raw_value *values, int *errors);
+int sensors_ctx_get_timed_value(sensors_ctx *ctx,
+				const sensors_chip_name *name, int subfeat_nr,
+				sensors_timed_value *value);
+int sensors_ctx_get_timed_values(sensors_ctx *ctx,
+				 const sensors_chip_name *name,
+				 const int *subfeat_nrs, int count,
+				 sensors_timed_value *values, int *errors);
+int sensors_ctx_create_plan(sensors_ctx *ctx,
+			    const sensors_chip_name * const *names,
+			    const int *subfeat_nrs, int count,
+			    sensors_plan **plan);
+int sensors_ctx_set_value(sensors_ctx *ctx, const sensors_chip_name *name,
+			  int subfeat_nr, double value);
+int sensors_ctx_do_chip_sets(sensors_ctx *ctx, const sensors_chip_name *name);
+void sensors_ctx_set_cache_time(sensors_ctx *ctx, int ms);
+void sensors_ctx_flush_values(sensors_ctx *ctx,
+			      const sensors_chip_name *match);
+int sensors_ctx_hotplug_process(sensors_ctx *ctx, int fd);
+int sensors_ctx_create_watch(sensors_ctx *ctx,
+			     const sensors_chip_name *match, int match_count,
+			     sensors_watch **watch);
+unsigned int sensors_ctx_get_chips_generation(sensors_ctx *ctx);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -25,7 +25,11 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/vfs.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -44,47 +48,73 @@
 #define SYSFS_MAGIC	0x62656572
 
 /*
- * Read an attribute from sysfs
+ * Discovery works on directory file descriptors, and looks up everything
+ * relative to them, so that the kernel doesn't have to resolve the full
+ * path of every attribute again and again.
+ */
+
+/* Open a directory relative to dir_fd. Returns a file descriptor, or -1. */
+static int sysfs_open_dir(int dir_fd, const char *name)
+{
+	return openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+/*
+ * Read an attribute from sysfs, relative to dir_fd (which may be AT_FDCWD)
  * Returns a pointer to a freshly allocated string; free it yourself.
  * If the file doesn't exist or can't be read, NULL is returned.
  */
-static char *sysfs_read_attr(const char *device, const char *attr)
+/* Same as sysfs_read_attr(), reading at most size - 1 bytes into buf */
+static char *sysfs_read_attr_buf(int dir_fd, const char *attr, char *buf,
+				 size_t size)
 {
-	char path[NAME_MAX];
-	char buf[ATTR_MAX], *p;
-	FILE *f;
-
-	snprintf(path, NAME_MAX, "%s/%s", device, attr);
+	char *p;
+	ssize_t len;
+	int fd;
 
-	if (!(f = fopen(path, "r")))
+	if ((fd = openat(dir_fd, attr, O_RDONLY | O_CLOEXEC)) < 0)
 		return NULL;
-	p = fgets(buf, ATTR_MAX, f);
-	fclose(f);
-	if (!p)
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len <= 0)
 		return NULL;
+	buf[len] = '\0';
 
-	/* Last byte is a '\n'; chop that off */
-	p = strndup(buf, strlen(buf) - 1);
+	/* Only keep the first line, without its '\n' */
+	p = strndup(buf, strcspn(buf, "\n"));
 	if (!p)
 		sensors_fatal_error(__func__, "Out of memory");
 	return p;
 }
 
+static char *sysfs_read_attr(int dir_fd, const char *attr)
+{
+	char buf[ATTR_MAX];
+
+	return sysfs_read_attr_buf(dir_fd, attr, buf, sizeof(buf));
+}
+
 /*
  * Call an arbitrary function for each class device of the given class
+ * The function gets the class directory fd, the device path and name,
+ * and data.
  * Returns 0 on success (all calls returned 0), a positive errno for
  * local errors, or a negative error value if any call fails.
  */
 static int sysfs_foreach_classdev(const char *class_name,
-				   int (*func)(const char *, const char *))
+				   int (*func)(int, const char *,
+					       const char *, void *),
+				   void *data)
 {
-	char path[NAME_MAX];
+	char path[PATH_MAX];
 	int path_off, ret;
 	DIR *dir;
 	struct dirent *ent;
 
-	path_off = snprintf(path, NAME_MAX, "%s/class/%s",
+	path_off = snprintf(path, sizeof(path), "%s/class/%s",
 			    sensors_sysfs_mount, class_name);
+	if (path_off >= (int)sizeof(path))
+		return ENAMETOOLONG;
 	if (!(dir = opendir(path)))
 		return errno;
 
@@ -93,9 +123,10 @@ static int sysfs_foreach_classdev(const char *class_name,
 		if (ent->d_name[0] == '.')	/* skip hidden entries */
 			continue;
 
-		snprintf(path + path_off, NAME_MAX - path_off, "/%s",
-			 ent->d_name);
-		ret = func(path, ent->d_name);
+		if (snprintf(path + path_off, sizeof(path) - path_off, "/%s",
+			     ent->d_name) >= (int)sizeof(path) - path_off)
+			continue;
+		ret = func(dirfd(dir), path, ent->d_name, data);
 	}
 
 	closedir(dir);
@@ -104,19 +135,25 @@ static int sysfs_foreach_classdev(const char *class_name,
 
 /*
  * Call an arbitrary function for each device of the given bus type
+ * The function gets the bus directory fd, the device path and name,
+ * and data.
  * Returns 0 on success (all calls returned 0), a positive errno for
  * local errors, or a negative error value if any call fails.
  */
 static int sysfs_foreach_busdev(const char *bus_type,
-				 int (*func)(const char *, const char *))
+				int (*func)(int, const char *,
+					    const char *, void *),
+				void *data)
 {
-	char path[NAME_MAX];
+	char path[PATH_MAX];
 	int path_off, ret;
 	DIR *dir;
 	struct dirent *ent;
 
-	path_off = snprintf(path, NAME_MAX, "%s/bus/%s/devices",
+	path_off = snprintf(path, sizeof(path), "%s/bus/%s/devices",
 			    sensors_sysfs_mount, bus_type);
+	if (path_off >= (int)sizeof(path))
+		return ENAMETOOLONG;
 	if (!(dir = opendir(path)))
 		return errno;
 
@@ -125,9 +162,10 @@ static int sysfs_foreach_busdev(const char *bus_type,
 		if (ent->d_name[0] == '.')	/* skip hidden entries */
 			continue;
 
-		snprintf(path + path_off, NAME_MAX - path_off, "/%s",
-			 ent->d_name);
-		ret = func(path, ent->d_name);
+		if (snprintf(path + path_off, sizeof(path) - path_off, "/%s",
+			     ent->d_name) >= (int)sizeof(path) - path_off)
+			continue;
+		ret = func(dirfd(dir), path, ent->d_name, data);
 	}
 
 	closedir(dir);
@@ -138,8 +176,7 @@ static int sysfs_foreach_busdev(const char *bus_type,
 
 char sensors_sysfs_mount[NAME_MAX];
 
-static
-int get_type_scaling(sensors_subfeature_type type)
+int sensors_get_type_scaling(sensors_subfeature_type type)
 {
 	/* Multipliers for subfeatures */
 	switch (type & 0xFF80) {
@@ -167,11 +204,11 @@ int get_type_scaling(sensors_subfeature_type type)
 	}
 }
 
+/* Return the length of the feature name, which is a prefix of the name
+   of its subfeatures */
 static
-char *get_feature_name(sensors_feature_type ftype, char *sfname)
+int get_feature_name_len(sensors_feature_type ftype, const char *sfname)
 {
-	char *name, *underscore;
-
 	switch (ftype) {
 	case SENSORS_FEATURE_IN:
 	case SENSORS_FEATURE_FAN:
@@ -181,19 +218,10 @@ char *get_feature_name(sensors_feature_type ftype, char *sfname)
 	case SENSORS_FEATURE_CURR:
 	case SENSORS_FEATURE_HUMIDITY:
 	case SENSORS_FEATURE_INTRUSION:
-		underscore = strchr(sfname, '_');
-		name = strndup(sfname, underscore - sfname);
-		if (!name)
-			sensors_fatal_error(__func__, "Out of memory");
-
-		break;
+		return strchr(sfname, '_') - sfname;
 	default:
-		name = strdup(sfname);
-		if (!name)
-			sensors_fatal_error(__func__, "Out of memory");
+		return strlen(sfname);
 	}
-
-	return name;
 }
 
 /* Static mappings for use by sensors_subfeature_get_type() */
@@ -329,26 +357,69 @@ static const struct subfeature_type_match intrusion_matches[] = {
 	{ "beep", SENSORS_SUBFEATURE_INTRUSION_BEEP },
 	{ NULL, 0 }
 };
-static struct feature_type_match matches[] = {
-	{ "temp%d%c", temp_matches },
-	{ "in%d%c", in_matches },
-	{ "fan%d%c", fan_matches },
-	{ "cpu%d%c", cpu_matches },
-	{ "power%d%c", power_matches },
-	{ "curr%d%c", curr_matches },
-	{ "energy%d%c", energy_matches },
-	{ "intrusion%d%c", intrusion_matches },
-	{ "humidity%d%c", humidity_matches },
+static const struct feature_type_match matches[] = {
+	{ "temp", temp_matches },
+	{ "in", in_matches },
+	{ "fan", fan_matches },
+	{ "cpu", cpu_matches },
+	{ "power", power_matches },
+	{ "curr", curr_matches },
+	{ "energy", energy_matches },
+	{ "intrusion", intrusion_matches },
+	{ "humidity", humidity_matches },
 };
 
+/*
+ * Subfeature names are looked up for every attribute of every chip, so
+ * the tables above are turned into a single hash table, keyed on the
+ * main feature and the subfeature name, the first time they are needed.
+ */
+#define SF_HASH_SIZE	512	/* power of 2, and way more than needed */
+
+static struct sf_hash_entry {
+	const char *name;		/* NULL if the slot is free */
+	int feature;			/* index in matches[] */
+	sensors_subfeature_type type;
+} sf_hash[SF_HASH_SIZE];
+
+static pthread_once_t sf_hash_once = PTHREAD_ONCE_INIT;
+
+/* FNV-1a */
+#define SF_HASH_INIT(feature)	((2166136261U ^ (feature)) * 16777619U)
+#define SF_HASH_ADD(h, c)	(((h) ^ (unsigned char)(c)) * 16777619U)
+
+static void sensors_init_sf_hash(void)
+{
+	const struct subfeature_type_match *submatches;
+	const char *p;
+	unsigned int h;
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(matches); i++) {
+		submatches = matches[i].submatches;
+		for (j = 0; submatches[j].name != NULL; j++) {
+			h = SF_HASH_INIT(i);
+			for (p = submatches[j].name; *p; p++)
+				h = SF_HASH_ADD(h, *p);
+
+			h &= SF_HASH_SIZE - 1;
+			while (sf_hash[h].name)
+				h = (h + 1) & (SF_HASH_SIZE - 1);
+			sf_hash[h].name = submatches[j].name;
+			sf_hash[h].feature = i;
+			sf_hash[h].type = submatches[j].type;
+		}
+	}
+}
+
 /* Return the subfeature type and channel number based on the subfeature
-   name */
-static
+   name. The name is parsed in a single pass: main feature prefix, channel
+   number, then the subfeature name, which is hashed on the way. */
 sensors_subfeature_type sensors_subfeature_get_type(const char *name, int *nr)
 {
-	char c;
-	int i, count;
-	const struct subfeature_type_match *submatches;
+	const char *p, *subname;
+	unsigned int h;
+	int i, len, n;
 
 	/* Special case */
 	if (!strcmp(name, "beep_enable")) {
@@ -356,18 +427,38 @@ sensors_subfeature_type sensors_subfeature_get_type(const char *name, int *nr)
 		return SENSORS_SUBFEATURE_BEEP_ENABLE;
 	}
 
+	pthread_once(&sf_hash_once, sensors_init_sf_hash);
+
+	for (p = name; *p >= 'a' && *p <= 'z'; p++)
+		;
+	len = p - name;
 	for (i = 0; i < ARRAY_SIZE(matches); i++)
-		if ((count = sscanf(name, matches[i].name, nr, &c)))
+		if (!strncmp(name, matches[i].name, len) &&
+		    matches[i].name[len] == '\0')
 			break;
-
-	if (i == ARRAY_SIZE(matches) || count != 2 || c != '_')
+	if (i == ARRAY_SIZE(matches) || *p < '0' || *p > '9')
 		return SENSORS_SUBFEATURE_UNKNOWN;  /* no match */
 
-	submatches = matches[i].submatches;
-	name = strchr(name + 3, '_') + 1;
-	for (i = 0; submatches[i].name != NULL; i++)
-		if (!strcmp(name, submatches[i].name))
-			return submatches[i].type;
+	for (n = 0; *p >= '0' && *p <= '9'; p++) {
+		if (n > (INT_MAX - 9) / 10)
+			return SENSORS_SUBFEATURE_UNKNOWN;
+		n = n * 10 + (*p - '0');
+	}
+	if (*p++ != '_')
+		return SENSORS_SUBFEATURE_UNKNOWN;
+
+	subname = p;
+	for (h = SF_HASH_INIT(i); *p; p++)
+		h = SF_HASH_ADD(h, *p);
+
+	for (h &= SF_HASH_SIZE - 1; sf_hash[h].name;
+	     h = (h + 1) & (SF_HASH_SIZE - 1)) {
+		if (sf_hash[h].feature == i &&
+		    !strcmp(sf_hash[h].name, subname)) {
+			*nr = n;
+			return sf_hash[h].type;
+		}
+	}
 
 	return SENSORS_SUBFEATURE_UNKNOWN;
 }
@@ -399,14 +490,12 @@ static int sensors_compute_max_sf(void)
 	return max;
 }
 
-static int sensors_get_attr_mode(const char *device, const char *attr)
+static int sensors_get_attr_mode(int dir_fd, const char *attr)
 {
-	char path[NAME_MAX];
 	struct stat st;
 	int mode = 0;
 
-	snprintf(path, NAME_MAX, "%s/%s", device, attr);
-	if (!stat(path, &st)) {
+	if (!fstatat(dir_fd, attr, &st, AT_SYMLINK_NOFOLLOW)) {
 		if (st.st_mode & S_IRUSR)
 			mode |= SENSORS_MODE_R;
 		if (st.st_mode & S_IWUSR)
@@ -415,31 +504,47 @@ static int sensors_get_attr_mode(const char *device, const char *attr)
 	return mode;
 }
 
-static int sensors_read_dynamic_chip(sensors_chip_features *chip,
-				     const char *dev_path)
+static int max_subfeatures, feature_size;
+
+/* Dynamically figure out the max number of subfeatures */
+static void sensors_init_max_sf(void)
+{
+	max_subfeatures = sensors_compute_max_sf();
+	feature_size = max_subfeatures * 2;
+}
+
+static int sensors_read_dynamic_chip(sensors_arena *arena,
+				     sensors_fd_cache *fc,
+				     sensors_chip_features *chip,
+				     int dev_fd)
 {
-	int i, fnum = 0, sfnum = 0, prev_slot;
-	static int max_subfeatures, feature_size;
+	static pthread_once_t max_sf_once = PTHREAD_ONCE_INIT;
+	int i, fd, err, len, fnum = 0, sfnum = 0, prev_slot;
+	size_t names_size = 0;
 	DIR *dir;
 	struct dirent *ent;
 	struct {
 		int count;
 		sensors_subfeature *sf;
 	} all_types[SENSORS_FEATURE_MAX];
+	sensors_arena scratch = SENSORS_ARENA_INITIALIZER;
 	sensors_subfeature *dyn_subfeatures;
 	sensors_feature *dyn_features;
 	sensors_feature_type ftype;
 	sensors_subfeature_type sftype;
+	char *names;
 
-	if (!(dir = opendir(dev_path)))
+	/* readdir() needs a file descriptor of its own */
+	if ((fd = sysfs_open_dir(dev_fd, ".")) < 0)
 		return -errno;
-
-	/* Dynamically figure out the max number of subfeatures */
-	if (!max_subfeatures) {
-		max_subfeatures = sensors_compute_max_sf();
-		feature_size = max_subfeatures * 2;
+	if (!(dir = fdopendir(fd))) {
+		err = -errno;
+		close(fd);
+		return err;
 	}
 
+	pthread_once(&max_sf_once, sensors_init_max_sf);
+
 	/* We use a set of large sparse tables at first (one per main
 	   feature type present) to store all found subfeatures, so that we
 	   can store them sorted and then later create a dense sorted table. */
@@ -520,17 +625,18 @@ static int sensors_read_dynamic_chip(sensors_chip_features *chip,
 			continue;
 		}
 
-		/* fill in the subfeature members */
+		/* fill in the subfeature members, the name is only stored
+		   temporarily */
 		all_types[ftype].sf[i].type = sftype;
-		all_types[ftype].sf[i].name = strdup(name);
-		if (!all_types[ftype].sf[i].name)
-			sensors_fatal_error(__func__, "Out of memory");
+		all_types[ftype].sf[i].name = sensors_arena_strdup(&scratch,
+								   name);
+		names_size += strlen(name) + 1;
 
 		/* Other and misc subfeatures are never scaled */
 		if (sftype < SENSORS_SUBFEATURE_VID && !(sftype & 0x80))
 			all_types[ftype].sf[i].flags |= SENSORS_COMPUTE_MAPPING;
 		all_types[ftype].sf[i].flags |=
-					sensors_get_attr_mode(dev_path, name);
+					sensors_get_attr_mode(dev_fd, name);
 
 		sfnum++;
 	}
@@ -538,6 +644,8 @@ static int sensors_read_dynamic_chip(sensors_chip_features *chip,
 
 	if (!sfnum) { /* No subfeature */
 		chip->subfeature = NULL;
+		chip->attr_fd = NULL;
+		chip->value_cache = NULL;
 		goto exit_free;
 	}
 
@@ -551,14 +659,18 @@ static int sensors_read_dynamic_chip(sensors_chip_features *chip,
 			if (i / feature_size != prev_slot) {
 				fnum++;
 				prev_slot = i / feature_size;
+				names_size += get_feature_name_len(ftype,
+						all_types[ftype].sf[i].name) + 1;
 			}
 		}
 	}
 
-	dyn_subfeatures = calloc(sfnum, sizeof(sensors_subfeature));
-	dyn_features = calloc(fnum, sizeof(sensors_feature));
-	if (!dyn_subfeatures || !dyn_features)
-		sensors_fatal_error(__func__, "Out of memory");
+	/* All names go to a single string table */
+	dyn_subfeatures = sensors_arena_alloc(arena,
+					      sfnum * sizeof(sensors_subfeature));
+	dyn_features = sensors_arena_alloc(arena,
+					   fnum * sizeof(sensors_feature));
+	names = sensors_arena_alloc(arena, names_size);
 
 	/* Copy from the sparse array to the compact array */
 	sfnum = 0;
@@ -574,15 +686,20 @@ static int sensors_read_dynamic_chip(sensors_chip_features *chip,
 				fnum++;
 				prev_slot = i / feature_size;
 
-				dyn_features[fnum].name =
-					get_feature_name(ftype,
+				len = get_feature_name_len(ftype,
 						all_types[ftype].sf[i].name);
+				memcpy(names, all_types[ftype].sf[i].name, len);
+				dyn_features[fnum].name = names;
+				names += len + 1;
 				dyn_features[fnum].number = fnum;
 				dyn_features[fnum].first_subfeature = sfnum;
 				dyn_features[fnum].type = ftype;
 			}
 
 			dyn_subfeatures[sfnum] = all_types[ftype].sf[i];
+			dyn_subfeatures[sfnum].name = strcpy(names,
+						all_types[ftype].sf[i].name);
+			names += strlen(names) + 1;
 			dyn_subfeatures[sfnum].number = sfnum;
 			/* Back to the feature */
 			dyn_subfeatures[sfnum].mapping = fnum;
@@ -595,10 +712,12 @@ static int sensors_read_dynamic_chip(sensors_chip_features *chip,
 	chip->subfeature_count = sfnum;
 	chip->feature = dyn_features;
 	chip->feature_count = ++fnum;
+	sensors_alloc_sysfs_attrs(arena, fc, chip);
 
 exit_free:
 	for (ftype = 0; ftype < SENSORS_FEATURE_MAX; ftype++)
 		free(all_types[ftype].sf);
+	sensors_arena_free(&scratch);
 	return 0;
 }
 
@@ -615,44 +734,44 @@ int sensors_init_sysfs(void)
 	return 1;
 }
 
-/* returns: number of devices added (0 or 1) if successful, <0 otherwise */
-static int sensors_read_one_sysfs_chip(const char *dev_path,
+/* returns: number of devices found (0 or 1) if successful, <0 otherwise.
+   The device found, if any, is stored in entry. dev_fd is -1 for virtual
+   devices. */
+static int sensors_read_one_sysfs_chip(sensors_arena *arena,
+				       int dev_fd,
 				       const char *dev_name,
-				       const char *hwmon_path)
+				       const char *hwmon_path,
+				       int hwmon_fd,
+				       sensors_chip_features *entry)
 {
 	int domain, bus, slot, fn, vendor, product, id;
 	int err = -SENSORS_ERR_KERNEL;
-	char *bus_attr;
-	char bus_path[NAME_MAX];
-	char linkpath[NAME_MAX];
-	char subsys_path[NAME_MAX], *subsys;
+	char *prefix, *bus_attr;
+	char bus_path[PATH_MAX];
+	char subsys_path[PATH_MAX], *subsys;
 	int sub_len;
-	sensors_chip_features entry;
 
 	/* ignore any device without name attribute */
-	if (!(entry.chip.prefix = sysfs_read_attr(hwmon_path, "name")))
+	if (!(prefix = sysfs_read_attr(hwmon_fd, "name")))
 		return 0;
+	memset(&entry->chip, 0, sizeof(entry->chip));
 
-	entry.chip.path = strdup(hwmon_path);
-	if (!entry.chip.path)
-		sensors_fatal_error(__func__, "Out of memory");
-
-	if (dev_path == NULL) {
+	if (dev_fd < 0) {
 		/* Virtual device */
-		entry.chip.bus.type = SENSORS_BUS_TYPE_VIRTUAL;
-		entry.chip.bus.nr = 0;
+		entry->chip.bus.type = SENSORS_BUS_TYPE_VIRTUAL;
+		entry->chip.bus.nr = 0;
 		/* For now we assume that virtual devices are unique */
-		entry.chip.addr = 0;
+		entry->chip.addr = 0;
 		goto done;
 	}
 
 	/* Find bus type */
-	snprintf(linkpath, NAME_MAX, "%s/subsystem", dev_path);
-	sub_len = readlink(linkpath, subsys_path, NAME_MAX - 1);
+	sub_len = readlinkat(dev_fd, "subsystem", subsys_path,
+			     sizeof(subsys_path) - 1);
 	if (sub_len < 0 && errno == ENOENT) {
 		/* Fallback to "bus" link for kernels <= 2.6.17 */
-		snprintf(linkpath, NAME_MAX, "%s/bus", dev_path);
-		sub_len = readlink(linkpath, subsys_path, NAME_MAX - 1);
+		sub_len = readlinkat(dev_fd, "bus", subsys_path,
+				     sizeof(subsys_path) - 1);
 	}
 	if (sub_len < 0) {
 		/* Older kernels (<= 2.6.11) have neither the subsystem
@@ -667,22 +786,22 @@ static int sensors_read_one_sysfs_chip(const char *dev_path,
 	}
 
 	if ((!subsys || !strcmp(subsys, "i2c")) &&
-	    sscanf(dev_name, "%hd-%x", &entry.chip.bus.nr,
-		   &entry.chip.addr) == 2) {
+	    sscanf(dev_name, "%hd-%x", &entry->chip.bus.nr,
+		   &entry->chip.addr) == 2) {
 		/* find out if legacy ISA or not */
-		if (entry.chip.bus.nr == 9191) {
-			entry.chip.bus.type = SENSORS_BUS_TYPE_ISA;
-			entry.chip.bus.nr = 0;
+		if (entry->chip.bus.nr == 9191) {
+			entry->chip.bus.type = SENSORS_BUS_TYPE_ISA;
+			entry->chip.bus.nr = 0;
 		} else {
-			entry.chip.bus.type = SENSORS_BUS_TYPE_I2C;
-			snprintf(bus_path, sizeof(bus_path),
-				"%s/class/i2c-adapter/i2c-%d/device",
-				sensors_sysfs_mount, entry.chip.bus.nr);
-
-			if ((bus_attr = sysfs_read_attr(bus_path, "name"))) {
+			entry->chip.bus.type = SENSORS_BUS_TYPE_I2C;
+			if (snprintf(bus_path, sizeof(bus_path),
+				     "%s/class/i2c-adapter/i2c-%d/device/name",
+				     sensors_sysfs_mount, entry->chip.bus.nr)
+			    < (int)sizeof(bus_path) &&
+			    (bus_attr = sysfs_read_attr(AT_FDCWD, bus_path))) {
 				if (!strncmp(bus_attr, "ISA ", 4)) {
-					entry.chip.bus.type = SENSORS_BUS_TYPE_ISA;
-					entry.chip.bus.nr = 0;
+					entry->chip.bus.type = SENSORS_BUS_TYPE_ISA;
+					entry->chip.bus.nr = 0;
 				}
 
 				free(bus_attr);
@@ -690,50 +809,50 @@ static int sensors_read_one_sysfs_chip(const char *dev_path,
 		}
 	} else
 	if ((!subsys || !strcmp(subsys, "spi")) &&
-	    sscanf(dev_name, "spi%hd.%d", &entry.chip.bus.nr,
-		   &entry.chip.addr) == 2) {
+	    sscanf(dev_name, "spi%hd.%d", &entry->chip.bus.nr,
+		   &entry->chip.addr) == 2) {
 		/* SPI */
-		entry.chip.bus.type = SENSORS_BUS_TYPE_SPI;
+		entry->chip.bus.type = SENSORS_BUS_TYPE_SPI;
 	} else
 	if ((!subsys || !strcmp(subsys, "pci")) &&
 	    sscanf(dev_name, "%x:%x:%x.%x", &domain, &bus, &slot, &fn) == 4) {
 		/* PCI */
-		entry.chip.addr = (domain << 16) + (bus << 8) + (slot << 3) + fn;
-		entry.chip.bus.type = SENSORS_BUS_TYPE_PCI;
-		entry.chip.bus.nr = 0;
+		entry->chip.addr = (domain << 16) + (bus << 8) + (slot << 3) + fn;
+		entry->chip.bus.type = SENSORS_BUS_TYPE_PCI;
+		entry->chip.bus.nr = 0;
 	} else
 	if ((!subsys || !strcmp(subsys, "platform") ||
 			!strcmp(subsys, "of_platform"))) {
 		/* must be new ISA (platform driver) */
-		if (sscanf(dev_name, "%*[a-z0-9_].%d", &entry.chip.addr) != 1)
-			entry.chip.addr = 0;
-		entry.chip.bus.type = SENSORS_BUS_TYPE_ISA;
-		entry.chip.bus.nr = 0;
+		if (sscanf(dev_name, "%*[a-z0-9_].%d", &entry->chip.addr) != 1)
+			entry->chip.addr = 0;
+		entry->chip.bus.type = SENSORS_BUS_TYPE_ISA;
+		entry->chip.bus.nr = 0;
 	} else if (subsys && !strcmp(subsys, "acpi")) {
-		entry.chip.bus.type = SENSORS_BUS_TYPE_ACPI;
+		entry->chip.bus.type = SENSORS_BUS_TYPE_ACPI;
 		/* For now we assume that acpi devices are unique */
-		entry.chip.bus.nr = 0;
-		entry.chip.addr = 0;
+		entry->chip.bus.nr = 0;
+		entry->chip.addr = 0;
 	} else
 	if (subsys && !strcmp(subsys, "hid") &&
 	    sscanf(dev_name, "%x:%x:%x.%x", &bus, &vendor, &product, &id) == 4) {
-		entry.chip.bus.type = SENSORS_BUS_TYPE_HID;
+		entry->chip.bus.type = SENSORS_BUS_TYPE_HID;
 		/* As of kernel 2.6.32, the hid device names don't look good */
-		entry.chip.bus.nr = bus;
-		entry.chip.addr = id;
+		entry->chip.bus.nr = bus;
+		entry->chip.addr = id;
 	} else
 	if (subsys && !strcmp(subsys, "mdio_bus")) {
-		if (sscanf(dev_name, "%*[^:]:%d", &entry.chip.addr) != 1)
-			entry.chip.addr = 0;
-		entry.chip.bus.type = SENSORS_BUS_TYPE_MDIO;
-		entry.chip.bus.nr = 0;
+		if (sscanf(dev_name, "%*[^:]:%d", &entry->chip.addr) != 1)
+			entry->chip.addr = 0;
+		entry->chip.bus.type = SENSORS_BUS_TYPE_MDIO;
+		entry->chip.bus.nr = 0;
 	} else
 	if (subsys && !strcmp(subsys, "scsi") &&
 	    sscanf(dev_name, "%d:%d:%d:%x", &domain, &bus, &slot, &fn) == 4) {
 		/* adapter(host), channel(bus), id(target), lun */
-		entry.chip.addr = (bus << 8) + (slot << 4) + fn;
-		entry.chip.bus.type = SENSORS_BUS_TYPE_SCSI;
-		entry.chip.bus.nr = domain;
+		entry->chip.addr = (bus << 8) + (slot << 4) + fn;
+		entry->chip.bus.type = SENSORS_BUS_TYPE_SCSI;
+		entry->chip.bus.nr = domain;
 	} else {
 		/* Ignore unknown device */
 		err = 0;
@@ -741,171 +860,1000 @@ static int sensors_read_one_sysfs_chip(const char *dev_path,
 	}
 
 done:
-	if (sensors_read_dynamic_chip(&entry, hwmon_path) < 0)
-		goto exit_free;
-	if (!entry.subfeature) { /* No subfeature, discard chip */
-		err = 0;
-		goto exit_free;
-	}
-	sensors_add_proc_chips(&entry);
-
-	return 1;
+	/* The features are only read when needed, see
+	   sensors_read_sysfs_features() */
+	entry->chip.prefix = sensors_arena_strdup(arena, prefix);
+	entry->chip.path = sensors_arena_strdup(arena, hwmon_path);
+	err = 1;
 
 exit_free:
-	free(entry.chip.prefix);
-	free(entry.chip.path);
+	free(prefix);
 	return err;
 }
 
-static int sensors_add_hwmon_device_compat(const char *path,
-					   const char *dev_name)
+static int sensors_add_hwmon_device_compat(int bus_fd, const char *path,
+					   const char *dev_name, void *data)
 {
-	int err;
+	sensors_ctx *ctx = data;
+	sensors_chip_features *chip;
+	int dev_fd, err;
 
-	err = sensors_read_one_sysfs_chip(path, dev_name, path);
-	if (err < 0)
-		return err;
-	return 0;
+	if ((dev_fd = sysfs_open_dir(bus_fd, dev_name)) < 0)
+		return 0;
+	chip = sensors_alloc_proc_chip();
+	err = sensors_read_one_sysfs_chip(&chip->arena, dev_fd, dev_name,
+					  path, dev_fd, chip);
+	close(dev_fd);
+	if (err > 0 && sensors_chip_wanted(ctx, &chip->chip))
+		sensors_add_proc_chips(sensors_proc_chips(ctx), &chip);
+	else
+		sensors_free_proc_chip(chip);
+	return err < 0 ? err : 0;
 }
 
 /* returns 0 if successful, !0 otherwise */
-static int sensors_read_sysfs_chips_compat(void)
+static int sensors_read_sysfs_chips_compat(sensors_ctx *ctx)
 {
 	int ret;
 
-	ret = sysfs_foreach_busdev("i2c", sensors_add_hwmon_device_compat);
+	ret = sysfs_foreach_busdev("i2c", sensors_add_hwmon_device_compat,
+				   ctx);
 	if (ret && ret != ENOENT)
 		return -SENSORS_ERR_KERNEL;
 
 	return 0;
 }
 
-static int sensors_add_hwmon_device(const char *path, const char *classdev)
+/* returns: number of devices found (0 or 1) if successful, <0 otherwise.
+   The device found, if any, is stored in entry. */
+static int sensors_read_hwmon_device(sensors_arena *arena,
+				     const char *path, int hwmon_fd,
+				     sensors_chip_features *entry)
 {
-	char linkpath[NAME_MAX];
-	char device[NAME_MAX], *device_p;
-	int dev_len, err;
-	(void)classdev; /* hide warning */
+	char linkpath[PATH_MAX];
+	char device[PATH_MAX], *device_p;
+	int dev_fd, dev_len, err;
 
-	snprintf(linkpath, NAME_MAX, "%s/device", path);
-	dev_len = readlink(linkpath, device, NAME_MAX - 1);
+	dev_len = readlinkat(hwmon_fd, "device", device, sizeof(device) - 1);
 	if (dev_len < 0) {
 		/* No device link? Treat as virtual */
-		err = sensors_read_one_sysfs_chip(NULL, NULL, path);
-	} else {
-		device[dev_len] = '\0';
-		device_p = strrchr(device, '/') + 1;
+		return sensors_read_one_sysfs_chip(arena, -1, NULL, path,
+						   hwmon_fd, entry);
+	}
+	device[dev_len] = '\0';
+	device_p = strrchr(device, '/') + 1;
 
-		/* The attributes we want might be those of the hwmon class
-		   device, or those of the device itself. */
-		err = sensors_read_one_sysfs_chip(linkpath, device_p, path);
-		if (err == 0)
-			err = sensors_read_one_sysfs_chip(linkpath, device_p,
-							  linkpath);
+	if ((dev_fd = sysfs_open_dir(hwmon_fd, "device")) < 0)
+		return 0;
+
+	/* The attributes we want might be those of the hwmon class
+	   device, or those of the device itself. */
+	err = sensors_read_one_sysfs_chip(arena, dev_fd, device_p, path,
+					  hwmon_fd, entry);
+	if (err == 0 && snprintf(linkpath, sizeof(linkpath), "%s/device",
+				 path) < (int)sizeof(linkpath)) {
+		err = sensors_read_one_sysfs_chip(arena, dev_fd, device_p,
+						  linkpath, dev_fd, entry);
 	}
-	if (err < 0)
-		return err;
-	return 0;
+	close(dev_fd);
+	return err;
+}
+
+/*
+ * Some drivers are slow to answer (for example ACPI, IPMI or PMBus based
+ * ones), so sensors_init() discovers the hwmon devices with a small pool
+ * of threads. Each job stores its result in a slot of its own, and the
+ * caller then looks at the slots in order, so the result is the same as
+ * with sequential processing.
+ */
+#define POOL_THREADS	8
+
+struct sensors_pool {
+	int count, next;
+	pthread_mutex_t lock;
+	void (*job)(void *data, int i);
+	void *data;
+};
+
+static void *sensors_pool_worker(void *arg)
+{
+	struct sensors_pool *pool = arg;
+	int i;
+
+	for (;;) {
+		pthread_mutex_lock(&pool->lock);
+		i = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+		if (i >= pool->count)
+			break;
+		pool->job(pool->data, i);
+	}
+	return NULL;
+}
+
+/* Run job(data, i) for i from 0 to count - 1 */
+static void sensors_run_pool(int count, void (*job)(void *, int), void *data)
+{
+	struct sensors_pool pool = { count, 0, PTHREAD_MUTEX_INITIALIZER,
+				     job, data };
+	pthread_t thread[POOL_THREADS - 1];
+	int i, threads;
+
+	/* The calling thread is a worker too */
+	threads = count < POOL_THREADS ? count : POOL_THREADS;
+	for (i = 0; i < threads - 1; i++)
+		if (pthread_create(&thread[i], NULL, sensors_pool_worker,
+				   &pool))
+			break;
+	threads = i;
+	sensors_pool_worker(&pool);
+	for (i = 0; i < threads; i++)
+		pthread_join(thread[i], NULL);
+}
+
+struct hwmon_device {
+	char path[PATH_MAX];
+	sensors_chip_features *chip;	/* NULL if not a device */
+	int res;
+};
+
+struct hwmon_discovery {
+	struct hwmon_device *dev;
+	int class_fd;		/* class/hwmon directory */
+	int name_off;		/* offset of the device name in path */
+};
+
+static void sensors_discover_device(void *data, int i)
+{
+	struct hwmon_discovery *d = data;
+	struct hwmon_device *dev = &d->dev[i];
+	int hwmon_fd;
+
+	hwmon_fd = sysfs_open_dir(d->class_fd, dev->path + d->name_off);
+	if (hwmon_fd < 0) {
+		dev->res = 0;
+		return;
+	}
+	dev->chip = sensors_alloc_proc_chip();
+	dev->res = sensors_read_hwmon_device(&dev->chip->arena, dev->path,
+					     hwmon_fd, dev->chip);
+	close(hwmon_fd);
 }
 
 /* returns 0 if successful, !0 otherwise */
-int sensors_read_sysfs_chips(void)
+int sensors_read_sysfs_chips(sensors_ctx *ctx)
 {
-	int ret;
+	struct hwmon_discovery d = { NULL, -1, 0 };
+	struct hwmon_device dev;
+	int i, count = 0, max = 0, ret = 0;
+	char path[PATH_MAX];
+	DIR *dir;
+	struct dirent *ent;
 
-	ret = sysfs_foreach_classdev("hwmon", sensors_add_hwmon_device);
-	if (ret == ENOENT) {
+	d.name_off = snprintf(path, sizeof(path), "%s/class/hwmon",
+			      sensors_sysfs_mount) + 1;
+	if (!(dir = opendir(path))) {
 		/* compatibility function for kernel 2.6.n where n <= 13 */
-		return sensors_read_sysfs_chips_compat();
+		if (errno == ENOENT)
+			return sensors_read_sysfs_chips_compat(ctx);
+		return -SENSORS_ERR_KERNEL;
+	}
+
+	memset(&dev, 0, sizeof(dev));
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')	/* skip hidden entries */
+			continue;
+
+		if (snprintf(dev.path, sizeof(dev.path), "%s/%s", path,
+			     ent->d_name) >= (int)sizeof(dev.path))
+			continue;
+		sensors_add_array_el(&dev, &d.dev, &count, &max,
+				     sizeof(struct hwmon_device));
 	}
+	d.class_fd = dirfd(dir);
+
+	sensors_run_pool(count, sensors_discover_device, &d);
+	closedir(dir);
+
+	/* On error, the caller frees the whole list, so we can add all the
+	   devices we found and simply report the first error */
+	for (i = 0; i < count; i++) {
+		if (d.dev[i].res > 0 &&
+		    sensors_chip_wanted(ctx, &d.dev[i].chip->chip)) {
+			sensors_add_proc_chips(sensors_proc_chips(ctx),
+					       &d.dev[i].chip);
+			continue;
+		}
+		if (d.dev[i].res < 0 && !ret)
+			ret = d.dev[i].res;
+		if (d.dev[i].chip)
+			sensors_free_proc_chip(d.dev[i].chip);
+	}
+	free(d.dev);
 
-	if (ret > 0)
-		ret = -SENSORS_ERR_KERNEL;
 	return ret;
 }
 
+/* The chips restored from the cache already have their features, but the
+   access rights of their attributes may have changed since */
+static void sensors_update_attr_modes(sensors_chip_features *chip, int dev_fd)
+{
+	sensors_subfeature *subfeature;
+	int i;
+
+	for (i = 0; i < chip->subfeature_count; i++) {
+		subfeature = &chip->subfeature[i];
+		subfeature->flags = (subfeature->flags &
+				     ~(SENSORS_MODE_R | SENSORS_MODE_W)) |
+				    sensors_get_attr_mode(dev_fd,
+							  subfeature->name);
+	}
+}
+
+static void sensors_load_features(sensors_ctx *ctx,
+				  sensors_chip_features *chip)
+{
+	int fd;
+
+	/* A chip which went away is left without features, or without
+	   access to them */
+	if ((fd = sysfs_open_dir(AT_FDCWD, chip->chip.path)) < 0) {
+		if (chip->subfeature)
+			sensors_update_attr_modes(chip, -1);
+		return;
+	}
+	if (chip->subfeature)
+		sensors_update_attr_modes(chip, fd);
+	else
+		sensors_read_dynamic_chip(&chip->arena, &ctx->fd_cache,
+					  chip, fd);
+	close(fd);
+}
+
+/* Unlike discovery, this runs from whatever call first needs the chips,
+   so it stays on the calling thread rather than spawning threads behind
+   the application's back */
+void sensors_read_sysfs_features(sensors_ctx *ctx,
+				 sensors_chip_features **chips, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		sensors_load_features(ctx, chips[i]);
+}
+
+/* returns: number of chips added (0 or 1) if successful, <0 otherwise */
+int sensors_read_sysfs_chip(sensors_ctx *ctx, sensors_chip_list *list,
+			    const char *name)
+{
+	sensors_chip_features *chip;
+	char path[PATH_MAX];
+	int hwmon_fd, err;
+
+	if (snprintf(path, sizeof(path), "%s/class/hwmon/%s",
+		     sensors_sysfs_mount, name) >= (int)sizeof(path) ||
+	    (hwmon_fd = sysfs_open_dir(AT_FDCWD, path)) < 0)
+		return 0;
+
+	chip = sensors_alloc_proc_chip();
+	err = sensors_read_hwmon_device(&chip->arena, path, hwmon_fd, chip);
+	close(hwmon_fd);
+	if (err <= 0 || !sensors_chip_wanted(ctx, &chip->chip)) {
+		sensors_free_proc_chip(chip);
+		return err < 0 ? err : 0;
+	}
+	sensors_add_proc_chips(list, &chip);
+	return 1;
+}
+
 /* returns 0 if successful, !0 otherwise */
-static int sensors_add_i2c_bus(const char *path, const char *classdev)
+static int sensors_add_i2c_bus(int class_fd, const char *path,
+			       const char *classdev, void *data)
 {
+	sensors_ctx *ctx = data;
 	sensors_bus entry;
+	int fd;
+	(void)path; /* hide warning */
 
 	if (sscanf(classdev, "i2c-%hd", &entry.bus.nr) != 1 ||
 	    entry.bus.nr == 9191) /* legacy ISA */
 		return 0;
 	entry.bus.type = SENSORS_BUS_TYPE_I2C;
 
+	if ((fd = sysfs_open_dir(class_fd, classdev)) < 0)
+		return 0;
+
 	/* Get the adapter name from the classdev "name" attribute
 	 * (Linux 2.6.20 and later). If it fails, fall back to
 	 * the device "name" attribute (for older kernels). */
-	entry.adapter = sysfs_read_attr(path, "name");
+	entry.adapter = sysfs_read_attr(fd, "name");
 	if (!entry.adapter)
-		entry.adapter = sysfs_read_attr(path, "device/name");
+		entry.adapter = sysfs_read_attr(fd, "device/name");
+	close(fd);
 	if (entry.adapter)
-		sensors_add_proc_bus(&entry);
+		sensors_add_proc_bus(ctx, &entry);
 
 	return 0;
 }
 
 /* returns 0 if successful, !0 otherwise */
-int sensors_read_sysfs_bus(void)
+int sensors_read_sysfs_bus(sensors_ctx *ctx)
 {
 	int ret;
 
-	ret = sysfs_foreach_classdev("i2c-adapter", sensors_add_i2c_bus);
+	ret = sysfs_foreach_classdev("i2c-adapter", sensors_add_i2c_bus,
+				     ctx);
 	if (ret == ENOENT)
-		ret = sysfs_foreach_busdev("i2c", sensors_add_i2c_bus);
+		ret = sysfs_foreach_busdev("i2c", sensors_add_i2c_bus, ctx);
 	if (ret && ret != ENOENT)
 		return -SENSORS_ERR_KERNEL;
 
 	return 0;
 }
 
-int sensors_read_sysfs_attr(const sensors_chip_name *name,
-			    const sensors_subfeature *subfeature,
-			    double *value)
+/*
+ * Attribute file descriptor cache
+ *
+ * Opening and closing an attribute file for every read is what dominates
+ * the cost of sensors_get_value(), so we keep the files open and re-read
+ * them with pread() at offset 0, which makes sysfs call the driver again.
+ *
+ * Each attribute has its own entry, whose descriptor, number of readers
+ * and pending close are packed into a single word: a cache hit is one
+ * atomic compare-and-swap, without any lock. Only cache misses take the
+ * lock of the context, to put the new entry in the ring of open files.
+ *
+ * The number of open files is capped to half of RLIMIT_NOFILE for the
+ * whole process. When the limit is reached, a file of the context is
+ * closed, chosen by the clock algorithm: the hand goes around the ring
+ * and closes the first file which wasn't read since it last passed. An
+ * entry which is being read by another thread is never closed, it is
+ * marked so that its last reader closes it.
+ */
+
+#define ATTR_FD_MASK	0xffffffffULL		/* fd + 1, 0 if none */
+#define ATTR_FD_USER	(1ULL << 32)		/* one reader */
+#define ATTR_FD_USERS	(0x3fffffffULL << 32)
+#define ATTR_FD_CLOSING	(1ULL << 63)		/* closed by last reader */
+
+static int attr_fd_count;	/* open files in all contexts */
+static int attr_fd_max;
+static pthread_once_t attr_fd_max_once = PTHREAD_ONCE_INIT;
+
+static void attr_fd_init_max(void)
 {
-	char n[NAME_MAX];
-	FILE *f;
+	struct rlimit rlim;
+
+	if (getrlimit(RLIMIT_NOFILE, &rlim) < 0)
+		attr_fd_max = 64;
+	else if (rlim.rlim_cur == RLIM_INFINITY ||
+		 rlim.rlim_cur / 2 > INT_MAX)
+		attr_fd_max = INT_MAX;
+	else
+		attr_fd_max = rlim.rlim_cur / 2;
+}
 
-	snprintf(n, NAME_MAX, "%s/%s", name->path, subfeature->name);
-	if ((f = fopen(n, "r"))) {
-		int res, err = 0;
+/* Remove entry i from the ring. Call with the lock held. */
+static void attr_fd_ring_remove(sensors_fd_cache *fc, int i)
+{
+	fc->ring[i]->in_ring = 0;
+	fc->ring[i] = fc->ring[--fc->count];
+	if (fc->hand >= fc->count)
+		fc->hand = 0;
+}
 
-		errno = 0;
-		res = fscanf(f, "%lf", value);
-		if (res == EOF && errno == EIO)
-			err = -SENSORS_ERR_IO;
-		else if (res != 1)
-			err = -SENSORS_ERR_ACCESS_R;
-		res = fclose(f);
-		if (err)
-			return err;
+/* Close a file of the context which wasn't read recently and isn't being
+   read. Returns 0 on success, -1 if all the files are in use. */
+static int attr_fd_evict(sensors_fd_cache *fc)
+{
+	sensors_attr_fd *afd;
+	unsigned long long state;
+	int steps, err = -1;
+
+	pthread_mutex_lock(&fc->lock);
+	for (steps = 2 * fc->count; steps > 0 && fc->count; steps--) {
+		afd = fc->ring[fc->hand];
+		state = __atomic_load_n(&afd->state, __ATOMIC_ACQUIRE);
+
+		/* Closed meanwhile, after a read error */
+		if (!state) {
+			attr_fd_ring_remove(fc, fc->hand);
+			continue;
+		}
+		if (__atomic_load_n(&afd->used, __ATOMIC_RELAXED)) {
+			__atomic_store_n(&afd->used, 0, __ATOMIC_RELAXED);
+		} else if (!(state & (ATTR_FD_USERS | ATTR_FD_CLOSING)) &&
+			   __atomic_compare_exchange_n(&afd->state, &state, 0,
+					0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			close((state & ATTR_FD_MASK) - 1);
+			__atomic_sub_fetch(&attr_fd_count, 1, __ATOMIC_RELAXED);
+			attr_fd_ring_remove(fc, fc->hand);
+			err = 0;
+			break;
+		}
+		fc->hand = (fc->hand + 1) % fc->count;
+	}
+	pthread_mutex_unlock(&fc->lock);
+	return err;
+}
 
-		if (res == EOF) {
-			if (errno == EIO)
-				return -SENSORS_ERR_IO;
-			else 
+/* Count one more open file, making room for it if needed. Returns 0 on
+   success, -1 if the file can't be cached. */
+static int attr_fd_reserve(sensors_fd_cache *fc)
+{
+	pthread_once(&attr_fd_max_once, attr_fd_init_max);
+
+	if (__atomic_add_fetch(&attr_fd_count, 1, __ATOMIC_RELAXED) <=
+	    attr_fd_max)
+		return 0;
+	__atomic_sub_fetch(&attr_fd_count, 1, __ATOMIC_RELAXED);
+
+	if (attr_fd_evict(fc) ||
+	    __atomic_add_fetch(&attr_fd_count, 1, __ATOMIC_RELAXED) >
+	    attr_fd_max) {
+		__atomic_sub_fetch(&attr_fd_count, 1, __ATOMIC_RELAXED);
+		return -1;
+	}
+	return 0;
+}
+
+/* Get an open file descriptor for the attribute, and mark it as in use.
+   Returns the descriptor on success, -1 on error (with errno set). The
+   descriptor must be released with attr_fd_put() when done. */
+static int attr_fd_get(const sensors_chip_features *chip,
+		       const sensors_subfeature *subfeature)
+{
+	sensors_attr_fd *afd = &chip->attr_fd[subfeature->number];
+	sensors_fd_cache *fc = chip->fd_cache;
+	unsigned long long state;
+	char n[PATH_MAX];
+	int fd;
+
+	state = __atomic_load_n(&afd->state, __ATOMIC_ACQUIRE);
+	while ((state & ATTR_FD_MASK) && !(state & ATTR_FD_CLOSING)) {
+		if (__atomic_compare_exchange_n(&afd->state, &state,
+						state + ATTR_FD_USER, 1,
+						__ATOMIC_ACQUIRE,
+						__ATOMIC_ACQUIRE)) {
+			if (!__atomic_load_n(&afd->used, __ATOMIC_RELAXED))
+				__atomic_store_n(&afd->used, 1,
+						 __ATOMIC_RELAXED);
+			return (state & ATTR_FD_MASK) - 1;
+		}
+	}
+
+	if (snprintf(n, sizeof(n), "%s/%s", chip->chip.path,
+		     subfeature->name) >= (int)sizeof(n)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	fd = open(n, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	/* Files of removed chips, and files opened while another thread
+	   was opening the same one, aren't cached */
+	if (__atomic_load_n(&afd->closed, __ATOMIC_ACQUIRE) ||
+	    attr_fd_reserve(fc))
+		return fd;
+	state = 0;
+	if (!__atomic_compare_exchange_n(&afd->state, &state,
+					 (fd + 1) | ATTR_FD_USER, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+		__atomic_sub_fetch(&attr_fd_count, 1, __ATOMIC_RELAXED);
+		return fd;
+	}
+
+	pthread_mutex_lock(&fc->lock);
+	if (!afd->in_ring) {
+		sensors_add_array_el(&afd, &fc->ring, &fc->count, &fc->max,
+				     sizeof(sensors_attr_fd *));
+		afd->in_ring = 1;
+	}
+	pthread_mutex_unlock(&fc->lock);
+	return fd;
+}
+
+/* Release a descriptor obtained from attr_fd_get(). If the read failed,
+   the cached file is closed so that the next read reopens it. */
+static void attr_fd_put(const sensors_chip_features *chip,
+			const sensors_subfeature *subfeature, int fd,
+			int failed)
+{
+	sensors_attr_fd *afd = &chip->attr_fd[subfeature->number];
+	unsigned long long state, new_state;
+
+	state = __atomic_load_n(&afd->state, __ATOMIC_RELAXED);
+	do {
+		/* Not cached. As long as we are using the cached file, no
+		   other open file can have the same descriptor. */
+		if ((state & ATTR_FD_MASK) != (unsigned long long)fd + 1) {
+			close(fd);
+			return;
+		}
+
+		new_state = state - ATTR_FD_USER;
+		if (failed)
+			new_state |= ATTR_FD_CLOSING;
+		if ((new_state & ATTR_FD_CLOSING) &&
+		    !(new_state & ATTR_FD_USERS))
+			new_state = 0;
+	} while (!__atomic_compare_exchange_n(&afd->state, &state, new_state,
+					      1, __ATOMIC_ACQ_REL,
+					      __ATOMIC_RELAXED));
+
+	if (!new_state) {
+		close(fd);
+		__atomic_sub_fetch(&attr_fd_count, 1, __ATOMIC_RELAXED);
+	}
+}
+
+static long long sysfs_clock(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long long sysfs_now(void)
+{
+	return sysfs_clock(CLOCK_MONOTONIC);
+}
+
+/* Allocate the cache of attribute files of a chip, from arena */
+void sensors_alloc_sysfs_attrs(sensors_arena *arena, sensors_fd_cache *fc,
+			       sensors_chip_features *chip)
+{
+	chip->fd_cache = fc;
+	chip->attr_fd = sensors_arena_alloc(arena,
+					    chip->subfeature_count *
+					    sizeof(sensors_attr_fd));
+
+	chip->value_cache = sensors_arena_alloc(arena,
+				sizeof(sensors_value_cache) +
+				chip->subfeature_count *
+				sizeof(struct sensors_cached_value));
+	chip->value_cache->update_interval = -1;
+	chip->value_cache->suspended = sysfs_clock(CLOCK_BOOTTIME) -
+				       sysfs_now();
+}
+
+/* Close all cached attribute files of a chip, and stop caching them. The
+   files still being read are closed by their last reader. The cache
+   itself belongs to the arena it was allocated from. */
+void sensors_close_sysfs_attrs(sensors_chip_features *chip)
+{
+	sensors_fd_cache *fc = chip->fd_cache;
+	sensors_attr_fd *afd;
+	unsigned long long state, new_state;
+	int i;
+
+	if (!chip->attr_fd)
+		return;
+
+	pthread_mutex_lock(&fc->lock);
+	for (i = 0; i < fc->count; i++)
+		if (fc->ring[i] >= chip->attr_fd &&
+		    fc->ring[i] < chip->attr_fd + chip->subfeature_count)
+			attr_fd_ring_remove(fc, i--);
+	pthread_mutex_unlock(&fc->lock);
+
+	for (i = 0; i < chip->subfeature_count; i++) {
+		afd = &chip->attr_fd[i];
+		__atomic_store_n(&afd->closed, 1, __ATOMIC_RELEASE);
+
+		state = __atomic_load_n(&afd->state, __ATOMIC_RELAXED);
+		do {
+			if (!(state & ATTR_FD_MASK))
+				break;
+			new_state = state & ATTR_FD_USERS ?
+				    state | ATTR_FD_CLOSING : 0;
+		} while (!__atomic_compare_exchange_n(&afd->state, &state,
+						      new_state, 1,
+						      __ATOMIC_ACQ_REL,
+						      __ATOMIC_RELAXED));
+
+		if ((state & ATTR_FD_MASK) && !new_state) {
+			close((state & ATTR_FD_MASK) - 1);
+			__atomic_sub_fetch(&attr_fd_count, 1,
+					   __ATOMIC_RELAXED);
+		}
+	}
+}
+
+/* Forget the ring of open files of a context, whose chips are all closed */
+void sensors_free_sysfs_attrs(sensors_fd_cache *fc)
+{
+	free(fc->ring);
+	fc->ring = NULL;
+	fc->count = fc->max = fc->hand = 0;
+}
+
+/* Parse the value of an attribute. The kernel exports integers, so parse
+   these by hand, exactly, into *raw. Anything else, including integers
+   out of the range of long long, is only parsed by strtod(), for the
+   double API. *value is set in any case. Returns 0 if *raw was set too,
+   1 if it wasn't, -1 if no number could be parsed. */
+static int sysfs_parse_value(const char *buf, long long *raw, double *value)
+{
+	const char *p = buf;
+	unsigned long long v = 0, limit;
+	int neg = 0, digits, d;
+	char *end;
+
+	if (*p == '-' || *p == '+')
+		neg = *p++ == '-';
+	/* -LLONG_MIN is LLONG_MAX + 1 */
+	limit = (unsigned long long)LLONG_MAX + neg;
+	for (digits = 0; *p >= '0' && *p <= '9'; p++, digits++) {
+		d = *p - '0';
+		if (v > (limit - d) / 10)
+			break;		/* out of range */
+		v = v * 10 + d;
+	}
+	if (digits && (*p == '\n' || *p == '\0')) {
+		*raw = neg && v ? -(long long)(v - 1) - 1 : (long long)v;
+		*value = *raw;
+		return 0;
+	}
+
+	*value = strtod(buf, &end);
+	if (end == buf)
+		return -1;
+	return 1;
+}
+
+/*
+ * Value cache
+ *
+ * Most drivers only read the registers of a chip again once their
+ * update_interval (in ms) has elapsed, and return the values they cached
+ * until then. Reading an attribute again within that time is useless, and
+ * for drivers without such a cache, slow. So each value read is kept with
+ * the time the read started, and served again until it is older than the
+ * update interval of the chip, or than the cache time set by the
+ * application if that is longer. Failed reads are not cached.
+ *
+ * Limits, fan dividers, sensor types, beep masks and the like rarely change
+ * unless written to, so these are kept SETTINGS_AGE_FACTOR times as long,
+ * and at least SETTINGS_MIN_AGE ms, which bounds how long a change made by
+ * another program goes unnoticed. All values of a chip are flushed whenever
+ * a value is written to the chip through us, when the application asks for
+ * it, when chips are hotplugged, and when the system resumes, as the
+ * firmware may have reprogrammed the chip meanwhile.
+ */
+
+#define SETTINGS_AGE_FACTOR	10
+#define SETTINGS_MIN_AGE	1000
+/* CLOCK_BOOTTIME jumping ahead of CLOCK_MONOTONIC by more than this means
+   the system was suspended */
+#define SUSPEND_MIN_TIME	100000000LL
+
+/* Return 1 if the subfeature type is a setting rather than a measurement,
+   0 otherwise */
+static int sensors_subfeature_is_static(sensors_subfeature_type type)
+{
+	switch (type) {
+	/* Measurements among the limits */
+	case SENSORS_SUBFEATURE_IN_INPUT:
+	case SENSORS_SUBFEATURE_IN_AVERAGE:
+	case SENSORS_SUBFEATURE_IN_LOWEST:
+	case SENSORS_SUBFEATURE_IN_HIGHEST:
+	case SENSORS_SUBFEATURE_FAN_INPUT:
+	case SENSORS_SUBFEATURE_TEMP_INPUT:
+	case SENSORS_SUBFEATURE_TEMP_LOWEST:
+	case SENSORS_SUBFEATURE_TEMP_HIGHEST:
+	case SENSORS_SUBFEATURE_POWER_AVERAGE:
+	case SENSORS_SUBFEATURE_POWER_AVERAGE_HIGHEST:
+	case SENSORS_SUBFEATURE_POWER_AVERAGE_LOWEST:
+	case SENSORS_SUBFEATURE_POWER_INPUT:
+	case SENSORS_SUBFEATURE_POWER_INPUT_HIGHEST:
+	case SENSORS_SUBFEATURE_POWER_INPUT_LOWEST:
+	case SENSORS_SUBFEATURE_ENERGY_INPUT:
+	case SENSORS_SUBFEATURE_CURR_INPUT:
+	case SENSORS_SUBFEATURE_CURR_AVERAGE:
+	case SENSORS_SUBFEATURE_CURR_LOWEST:
+	case SENSORS_SUBFEATURE_CURR_HIGHEST:
+	case SENSORS_SUBFEATURE_HUMIDITY_INPUT:
+	case SENSORS_SUBFEATURE_INTRUSION_ALARM:
+		return 0;
+	/* Settings among the alarms */
+	case SENSORS_SUBFEATURE_IN_BEEP:
+	case SENSORS_SUBFEATURE_FAN_DIV:
+	case SENSORS_SUBFEATURE_FAN_BEEP:
+	case SENSORS_SUBFEATURE_FAN_PULSES:
+	case SENSORS_SUBFEATURE_TEMP_TYPE:
+	case SENSORS_SUBFEATURE_TEMP_OFFSET:
+	case SENSORS_SUBFEATURE_TEMP_BEEP:
+	case SENSORS_SUBFEATURE_POWER_AVERAGE_INTERVAL:
+	case SENSORS_SUBFEATURE_CURR_BEEP:
+		return 1;
+	default:
+		/* Limits, vid, beep_enable; unknown types are measurements */
+		return type != SENSORS_SUBFEATURE_UNKNOWN && !(type & 0x80);
+	}
+}
+
+/* Return how long the value of a subfeature can be cached, in ns */
+static long long value_cache_max_age(const sensors_chip_features *chip,
+				     const sensors_subfeature *subfeature)
+{
+	sensors_value_cache *vc = chip->value_cache;
+	char attr[PATH_MAX], *value;
+	int interval, cache_time;
+
+	interval = __atomic_load_n(&vc->update_interval, __ATOMIC_RELAXED);
+	if (interval < 0) {
+		/* Read it once, chips without it have no register cache */
+		interval = 0;
+		if (snprintf(attr, sizeof(attr), "%s/update_interval",
+			     chip->chip.path) < (int)sizeof(attr) &&
+		    (value = sysfs_read_attr(AT_FDCWD, attr))) {
+			interval = atoi(value);
+			if (interval < 0)
+				interval = 0;
+			free(value);
+		}
+		__atomic_store_n(&vc->update_interval, interval,
+				 __ATOMIC_RELAXED);
+	}
+
+	cache_time = __atomic_load_n(&vc->cache_time, __ATOMIC_RELAXED);
+	if (cache_time > interval)
+		interval = cache_time;
+
+	if (sensors_subfeature_is_static(subfeature->type)) {
+		interval *= SETTINGS_AGE_FACTOR;
+		if (interval < SETTINGS_MIN_AGE)
+			interval = SETTINGS_MIN_AGE;
+	}
+	return interval * 1000000LL;
+}
+
+/* Flush the values of the chip if the system was suspended since the last
+   call, now being the current CLOCK_MONOTONIC time. Returns 1 if it was,
+   0 otherwise. */
+static int value_cache_check_resume(const sensors_chip_features *chip,
+				    long long now)
+{
+	sensors_value_cache *vc = chip->value_cache;
+	long long offset, last;
+
+	offset = sysfs_clock(CLOCK_BOOTTIME) - now;
+	last = __atomic_load_n(&vc->suspended, __ATOMIC_RELAXED);
+	if (offset - last < SUSPEND_MIN_TIME)
+		return 0;
+
+	/* Only one of the threads noticing it needs to flush */
+	if (__atomic_compare_exchange_n(&vc->suspended, &last, offset, 0,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		sensors_flush_sysfs_values(chip);
+	return 1;
+}
+
+void sensors_set_sysfs_cache_time(sensors_chip_features *chip, int ms)
+{
+	if (chip->value_cache)
+		__atomic_store_n(&chip->value_cache->cache_time, ms,
+				 __ATOMIC_RELAXED);
+}
+
+/* Values are dropped all at once, by making them all stale */
+void sensors_flush_sysfs_values(const sensors_chip_features *chip)
+{
+	if (chip->value_cache)
+		__atomic_add_fetch(&chip->value_cache->flushes, 1,
+				   __ATOMIC_RELEASE);
+}
+
+/* Each cached value is protected by a sequence number, odd while it is
+   being updated: readers copy it without taking any lock, and try again
+   if it changed meanwhile. Returns 1 if the cached value is still valid,
+   0 otherwise. */
+static int value_cache_get(const struct sensors_cached_value *cached,
+			   unsigned int flushes, long long now,
+			   long long max_age, struct sensors_cached_value *copy)
+{
+	unsigned int seq;
+
+	do {
+		seq = __atomic_load_n(&cached->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			return 0;	/* don't wait for the writer */
+		copy->flushes = __atomic_load_n(&cached->flushes,
+						__ATOMIC_RELAXED);
+		copy->time = __atomic_load_n(&cached->time, __ATOMIC_RELAXED);
+		copy->end = __atomic_load_n(&cached->end, __ATOMIC_RELAXED);
+		copy->exact = __atomic_load_n(&cached->exact, __ATOMIC_RELAXED);
+		copy->raw = __atomic_load_n(&cached->raw, __ATOMIC_RELAXED);
+		__atomic_load(&cached->value, &copy->value, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (__atomic_load_n(&cached->seq, __ATOMIC_RELAXED) != seq);
+
+	return copy->time && copy->flushes == flushes &&
+	       now - copy->time < max_age;
+}
+
+/* Cache a value read from the attribute, unless another thread is doing
+   the same or already cached a more recent one */
+static void value_cache_put(struct sensors_cached_value *cached,
+			    unsigned int flushes, long long start,
+			    long long end, int exact, long long raw,
+			    double value)
+{
+	unsigned int seq;
+
+	seq = __atomic_load_n(&cached->seq, __ATOMIC_RELAXED);
+	if ((seq & 1) ||
+	    !__atomic_compare_exchange_n(&cached->seq, &seq, seq + 1, 0,
+					 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	if (__atomic_load_n(&cached->flushes, __ATOMIC_RELAXED) != flushes ||
+	    __atomic_load_n(&cached->time, __ATOMIC_RELAXED) < start) {
+		__atomic_store_n(&cached->flushes, flushes, __ATOMIC_RELAXED);
+		__atomic_store_n(&cached->time, start, __ATOMIC_RELAXED);
+		__atomic_store_n(&cached->end, end, __ATOMIC_RELAXED);
+		__atomic_store_n(&cached->exact, exact, __ATOMIC_RELAXED);
+		__atomic_store_n(&cached->raw, raw, __ATOMIC_RELAXED);
+		__atomic_store(&cached->value, &value, __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&cached->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/* Read the unscaled value of a subfeature, as sysfs_parse_value() parses
+   it, or the value cached for it. *start and *end are set to the times the
+   read started and ended, which for a cached value are those of the read
+   it comes from. If raw isn't NULL, the value must be an integer, which is
+   stored there. */
+static int sysfs_read_value(const sensors_chip_features *chip,
+			    const sensors_subfeature *subfeature,
+			    long long *raw, double *value,
+			    long long *start, long long *end)
+{
+	sensors_value_cache *vc = chip->value_cache;
+	struct sensors_cached_value *cached = &vc->value[subfeature->number];
+	struct sensors_cached_value copy;
+	char buf[ATTR_MAX];
+	ssize_t len;
+	long long max_age, now, r = 0;
+	unsigned int flushes = 0;
+	int fd, res, exact = 0, err = 0;
+
+	max_age = value_cache_max_age(chip, subfeature);
+	now = sysfs_now();
+	if (max_age) {
+		/* Values cached before this are stale */
+		flushes = __atomic_load_n(&vc->flushes, __ATOMIC_ACQUIRE);
+		if (value_cache_get(cached, flushes, now, max_age, &copy) &&
+		    !value_cache_check_resume(chip, now)) {
+			if (raw && !copy.exact)
 				return -SENSORS_ERR_ACCESS_R;
+			if (raw)
+				*raw = copy.raw;
+			*value = copy.value;
+			*start = copy.time;
+			*end = copy.end;
+			return 0;
 		}
-		*value /= get_type_scaling(subfeature->type);
-	} else
+	}
+
+	if ((fd = attr_fd_get(chip, subfeature)) < 0)
 		return -SENSORS_ERR_KERNEL;
 
+	len = pread(fd, buf, sizeof(buf) - 1, 0);
+	*start = now;
+	*end = sysfs_now();
+	if (len < 0)
+		err = errno == EIO ? -SENSORS_ERR_IO : -SENSORS_ERR_ACCESS_R;
+	else {
+		buf[len] = '\0';
+		if ((res = sysfs_parse_value(buf, &r, value)) < 0)
+			err = -SENSORS_ERR_ACCESS_R;
+		exact = res == 0;
+	}
+	attr_fd_put(chip, subfeature, fd, len < 0);
+
+	/* Unless the values were flushed while we were reading */
+	if (max_age && !err &&
+	    __atomic_load_n(&vc->flushes, __ATOMIC_ACQUIRE) == flushes)
+		value_cache_put(cached, flushes, now, *end, exact, r, *value);
+
+	if (!err && raw) {
+		if (!exact)
+			return -SENSORS_ERR_ACCESS_R;
+		*raw = r;
+	}
+	return err;
+}
+
+int sensors_read_sysfs_value(const sensors_chip_features *chip,
+			     const sensors_subfeature *subfeature,
+			     double *value)
+{
+	long long start, end;
+
+	return sysfs_read_value(chip, subfeature, NULL, value, &start, &end);
+}
+
+int sensors_read_sysfs_timed(const sensors_chip_features *chip,
+			     const sensors_subfeature *subfeature,
+			     double *value, long long *start, long long *end)
+{
+	return sysfs_read_value(chip, subfeature, NULL, value, start, end);
+}
+
+int sensors_read_sysfs_raw(const sensors_chip_features *chip,
+			   const sensors_subfeature *subfeature,
+			   long long *raw)
+{
+	long long start, end;
+	double value;
+
+	return sysfs_read_value(chip, subfeature, raw, &value, &start, &end);
+}
+
+int sensors_read_sysfs_attr(const sensors_chip_features *chip,
+			    const sensors_subfeature *subfeature,
+			    double *value)
+{
+	int err;
+
+	err = sensors_read_sysfs_value(chip, subfeature, value);
+	if (err)
+		return err;
+
+	*value /= sensors_get_type_scaling(subfeature->type);
 	return 0;
 }
 
-int sensors_write_sysfs_attr(const sensors_chip_name *name,
+void sensors_read_sysfs_labels(sensors_arena *arena,
+			       const sensors_chip_features *chip,
+			       const char **label)
+{
+	char attr[PATH_MAX], buf[PATH_MAX], *value;
+	int dir_fd, i;
+
+	if ((dir_fd = sysfs_open_dir(AT_FDCWD, chip->chip.path)) < 0)
+		return;
+
+	for (i = 0; i < chip->feature_count; i++) {
+		if (label[i])
+			continue;
+		if (snprintf(attr, sizeof(attr), "%s_label",
+			     chip->feature[i].name) >= (int)sizeof(attr))
+			continue;
+		/* Labels may be longer than values */
+		if ((value = sysfs_read_attr_buf(dir_fd, attr, buf,
+						 sizeof(buf)))) {
+			label[i] = sensors_arena_strdup(arena, value);
+			free(value);
+		}
+	}
+	close(dir_fd);
+}
+
+int sensors_write_sysfs_attr(const sensors_chip_features *chip,
 			     const sensors_subfeature *subfeature,
 			     double value)
 {
-	char n[NAME_MAX];
+	char n[PATH_MAX];
 	FILE *f;
 
-	snprintf(n, NAME_MAX, "%s/%s", name->path, subfeature->name);
+	/* Whatever happens, the values we had are no longer trusted. Drivers
+	   may adjust other limits too, e.g. fan_min when fan_div changes. */
+	sensors_flush_sysfs_values(chip);
+
+	if (snprintf(n, sizeof(n), "%s/%s", chip->chip.path,
+		     subfeature->name) >= (int)sizeof(n))
+		return -SENSORS_ERR_KERNEL;
 	if ((f = fopen(n, "w"))) {
 		int res, err = 0;
 
-		value *= get_type_scaling(subfeature->type);
+		value *= sensors_get_type_scaling(subfeature->type);
 		res = fprintf(f, "%d", (int) value);
 		if (res == -EIO)
 			err = -SENSORS_ERR_IO;
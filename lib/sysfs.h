@@ -26,17 +26,83 @@ extern char sensors_sysfs_mount[];
 
 int sensors_init_sysfs(void);
 
-int sensors_read_sysfs_chips(void);
+/* Read the detected chips the application is interested in, and the i2c
+   adapter names, into ctx */
+int sensors_read_sysfs_chips(sensors_ctx *ctx);
 
-int sensors_read_sysfs_bus(void);
+int sensors_read_sysfs_bus(sensors_ctx *ctx);
+
+/* Read hwmon class device name, such as "hwmon0", and add it to list, a
+   chips list of ctx, if it is a chip the application is interested in.
+   Returns the number of chips added (0 or 1), or <0 on error. */
+int sensors_read_sysfs_chip(sensors_ctx *ctx, sensors_chip_list *list,
+			    const char *name);
+
+/* Read the features and subfeatures of count detected chips of ctx.
+   Chips which can't be read are left without features. Chips restored
+   from the cache only get the access rights of their attributes updated. */
+void sensors_read_sysfs_features(sensors_ctx *ctx,
+				 sensors_chip_features **chips, int count);
+
+/* Return the subfeature type and channel number of a sysfs attribute, or
+   SENSORS_SUBFEATURE_UNKNOWN */
+sensors_subfeature_type sensors_subfeature_get_type(const char *name, int *nr);
+
+/* Return the factor by which the kernel value of a subfeature type is
+   scaled */
+int sensors_get_type_scaling(sensors_subfeature_type type);
+
+/* Read the unscaled value out of a sysfs attribute file */
+int sensors_read_sysfs_value(const sensors_chip_features *chip,
+			     const sensors_subfeature *subfeature,
+			     double *value);
+
+/* Same as sensors_read_sysfs_value(), also returning the times the read
+   started and ended, in ns of CLOCK_MONOTONIC */
+int sensors_read_sysfs_timed(const sensors_chip_features *chip,
+			     const sensors_subfeature *subfeature,
+			     double *value, long long *start, long long *end);
+
+/* Read the unscaled value out of a sysfs attribute file, as an integer */
+int sensors_read_sysfs_raw(const sensors_chip_features *chip,
+			   const sensors_subfeature *subfeature,
+			   long long *raw);
 
 /* Read a value out of a sysfs attribute file */
-int sensors_read_sysfs_attr(const sensors_chip_name *name,
+int sensors_read_sysfs_attr(const sensors_chip_features *chip,
 			    const sensors_subfeature *subfeature,
 			    double *value);
 
+/* Allocate the cache of attribute files used by sensors_read_sysfs_attr(),
+   from arena. Open files are kept in fc, the one of the context. */
+void sensors_alloc_sysfs_attrs(sensors_arena *arena, sensors_fd_cache *fc,
+			       sensors_chip_features *chip);
+
+/* Set the minimum time the values read by sensors_read_sysfs_attr() are
+   cached, in ms */
+void sensors_set_sysfs_cache_time(sensors_chip_features *chip, int ms);
+
+/* Drop the values of a chip cached by sensors_read_sysfs_attr() */
+void sensors_flush_sysfs_values(const sensors_chip_features *chip);
+
+/* Close the attribute files kept open by sensors_read_sysfs_attr(), and
+   stop keeping them open, when the chip is removed. Reads in progress
+   can complete. */
+void sensors_close_sysfs_attrs(sensors_chip_features *chip);
+
+/* Free the list of open files of a context, once all its chips are
+   closed */
+void sensors_free_sysfs_attrs(sensors_fd_cache *fc);
+
+/* Read the _label attribute of the features of a detected chip, into
+   arena. Only features for which label[i] is NULL are looked at, and
+   label[i] is left NULL if feature i has no label. */
+void sensors_read_sysfs_labels(sensors_arena *arena,
+			       const sensors_chip_features *chip,
+			       const char **label);
+
 /* Write a value to a sysfs attribute file */
-int sensors_write_sysfs_attr(const sensors_chip_name *name,
+int sensors_write_sysfs_attr(const sensors_chip_features *chip,
 			     const sensors_subfeature *subfeature,
 			     double value);
 
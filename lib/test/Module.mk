@@ -1,8 +1,12 @@
 LIB_DIR		:= lib
 LIB_TEST_DIR	:= lib/test
 
-LIB_TEST_TARGETS := $(LIB_TEST_DIR)/test-scanner
-LIB_TEST_SOURCES := $(LIB_TEST_DIR)/test-scanner.c
+LIB_TEST_TARGETS := $(LIB_TEST_DIR)/test-scanner $(LIB_TEST_DIR)/bench-init \
+		    $(LIB_TEST_DIR)/bench-classify $(LIB_TEST_DIR)/bench-expr \
+		    $(LIB_TEST_DIR)/test-hotplug $(LIB_TEST_DIR)/test-watch
+LIB_TEST_SOURCES := $(LIB_TEST_DIR)/test-scanner.c $(LIB_TEST_DIR)/bench-init.c \
+		    $(LIB_TEST_DIR)/bench-classify.c $(LIB_TEST_DIR)/bench-expr.c \
+		    $(LIB_TEST_DIR)/test-hotplug.c $(LIB_TEST_DIR)/test-watch.c
 
 LIB_TEST_SCANNER_OBJS := \
 	$(LIB_TEST_DIR)/test-scanner.ro \
@@ -13,10 +17,30 @@ LIB_TEST_SCANNER_OBJS := \
 $(LIB_TEST_DIR)/test-scanner: $(LIB_TEST_SCANNER_OBJS)
 	$(CC) $(EXLDFLAGS) -o $@ $(LIB_TEST_SCANNER_OBJS) -Llib
 
+$(LIB_TEST_DIR)/bench-init: $(LIB_TEST_DIR)/bench-init.ro $(LIBSTOBJECTS)
+	$(CC) $(EXLDFLAGS) -o $@ $(LIB_TEST_DIR)/bench-init.ro $(LIBSTOBJECTS) -lm -lpthread
+
+$(LIB_TEST_DIR)/bench-classify: $(LIB_TEST_DIR)/bench-classify.ro $(LIBSTOBJECTS)
+	$(CC) $(EXLDFLAGS) -o $@ $(LIB_TEST_DIR)/bench-classify.ro $(LIBSTOBJECTS) -lm -lpthread
+
+$(LIB_TEST_DIR)/bench-expr: $(LIB_TEST_DIR)/bench-expr.ro $(LIBSTOBJECTS)
+	$(CC) $(EXLDFLAGS) -o $@ $(LIB_TEST_DIR)/bench-expr.ro $(LIBSTOBJECTS) -lm -lpthread
+
+$(LIB_TEST_DIR)/test-hotplug: $(LIB_TEST_DIR)/test-hotplug.ro $(LIBSTOBJECTS)
+	$(CC) $(EXLDFLAGS) -o $@ $(LIB_TEST_DIR)/test-hotplug.ro $(LIBSTOBJECTS) -lm -lpthread
+
+$(LIB_TEST_DIR)/test-watch: $(LIB_TEST_DIR)/test-watch.ro $(LIBSTOBJECTS)
+	$(CC) $(EXLDFLAGS) -o $@ $(LIB_TEST_DIR)/test-watch.ro $(LIBSTOBJECTS) -lm -lpthread
+
 all-lib-test: $(LIB_TEST_TARGETS)
 user :: all-lib-test
 
 $(LIB_TEST_DIR)/test-scanner.ro: $(LIB_DIR)/data.h $(LIB_DIR)/conf.h $(LIB_DIR)/conf-parse.h $(LIB_DIR)/scanner.h
+$(LIB_TEST_DIR)/bench-init.ro: $(LIB_DIR)/sensors.h $(LIB_DIR)/error.h
+$(LIB_TEST_DIR)/bench-classify.ro: $(LIB_DIR)/sensors.h $(LIB_DIR)/data.h $(LIB_DIR)/general.h $(LIB_DIR)/sysfs.h
+$(LIB_TEST_DIR)/bench-expr.ro: $(LIB_DIR)/sensors.h $(LIB_DIR)/data.h $(LIB_DIR)/error.h $(LIB_DIR)/general.h $(LIB_DIR)/access.h $(LIB_DIR)/conf.h $(LIB_DIR)/scanner.h $(LIB_DIR)/expr.h
+$(LIB_TEST_DIR)/test-hotplug.ro: $(LIB_DIR)/sensors.h $(LIB_DIR)/data.h $(LIB_DIR)/access.h $(LIB_DIR)/sysfs.h $(LIB_DIR)/hotplug.h
+$(LIB_TEST_DIR)/test-watch.ro: $(LIB_DIR)/sensors.h $(LIB_DIR)/data.h $(LIB_DIR)/access.h $(LIB_DIR)/sysfs.h
 
 clean-lib-test:
 	$(RM) $(LIB_TEST_DIR)/*.rd $(LIB_TEST_DIR)/*.ro 
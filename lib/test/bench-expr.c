@@ -0,0 +1,260 @@
+/*
+    bench-expr.c - Benchmark of the compute expression evaluation.
+    Copyright (C) 2026 The lm-sensors developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2 of the License.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+/*
+ * Compare the compiled compute expressions with the tree walker libsensors
+ * used to have, both for speed and for results. The expressions are taken
+ * from the configuration files given on the command line, typically all
+ * the files under configs/. Expressions referencing other subfeatures are
+ * skipped, as they would need a chip to read from.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "../sensors.h"
+#include "../data.h"
+#include "../error.h"
+#include "../general.h"
+#include "../access.h"
+#include "../conf.h"
+#include "../scanner.h"
+#include "../expr.h"
+
+#define TEST_VALUE	12.34
+
+static const sensors_expr **exprs;
+static int exprs_count, exprs_max;
+
+/* The tree walker libsensors used to have, for reference */
+static int old_eval_expr(const sensors_expr *expr, double val, double *result)
+{
+	double res1, res2;
+	int res;
+
+	if (expr->kind == sensors_kind_val) {
+		*result = expr->data.val;
+		return 0;
+	}
+	if (expr->kind == sensors_kind_source) {
+		*result = val;
+		return 0;
+	}
+	if (expr->kind == sensors_kind_var)
+		return -SENSORS_ERR_NO_ENTRY;
+	if ((res = old_eval_expr(expr->data.subexpr.sub1, val, &res1)))
+		return res;
+	if (expr->data.subexpr.sub2 &&
+	    (res = old_eval_expr(expr->data.subexpr.sub2, val, &res2)))
+		return res;
+	switch (expr->data.subexpr.op) {
+	case sensors_add:
+		*result = res1 + res2;
+		return 0;
+	case sensors_sub:
+		*result = res1 - res2;
+		return 0;
+	case sensors_multiply:
+		*result = res1 * res2;
+		return 0;
+	case sensors_divide:
+		if (res2 == 0.0)
+			return -SENSORS_ERR_DIV_ZERO;
+		*result = res1 / res2;
+		return 0;
+	case sensors_negate:
+		*result = -res1;
+		return 0;
+	case sensors_exp:
+		*result = exp(res1);
+		return 0;
+	case sensors_log:
+		if (res1 < 0.0)
+			return -SENSORS_ERR_DIV_ZERO;
+		*result = log(res1);
+		return 0;
+	}
+	return 0;
+}
+
+static int has_vars(const sensors_expr *expr)
+{
+	switch (expr->kind) {
+	case sensors_kind_var:
+		return 1;
+	case sensors_kind_sub:
+		return has_vars(expr->data.subexpr.sub1) ||
+		       (expr->data.subexpr.sub2 &&
+			has_vars(expr->data.subexpr.sub2));
+	default:
+		return 0;
+	}
+}
+
+static int count_nodes(const sensors_expr *expr)
+{
+	if (expr->kind != sensors_kind_sub)
+		return 1;
+	return 1 + count_nodes(expr->data.subexpr.sub1) +
+	       (expr->data.subexpr.sub2 ?
+		count_nodes(expr->data.subexpr.sub2) : 0);
+}
+
+static void add_expr(const sensors_expr *expr)
+{
+	if (!has_vars(expr))
+		sensors_add_array_el(&expr, &exprs, &exprs_count, &exprs_max,
+				     sizeof(expr));
+}
+
+static int parse_file(const char *name)
+{
+	FILE *input;
+	char *name_copy;
+	int err;
+
+	input = fopen(name, "r");
+	if (!input) {
+		perror(name);
+		return -1;
+	}
+
+	name_copy = strdup(name);
+	if (!name_copy)
+		sensors_fatal_error(__func__, "Out of memory");
+	sensors_add_config_files(&sensors_default_ctx, &name_copy);
+
+	err = sensors_scanner_init(input, name_copy);
+	if (!err) {
+		err = sensors_yyparse();
+		sensors_scanner_exit();
+	}
+	fclose(input);
+
+	return err;
+}
+
+static double elapsed_ns(const struct timespec *start,
+			 const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e9 +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+	const sensors_chip *chip;
+	sensors_chip_features chip_features;
+	sensors_snapshot snapshot;
+	sensors_arena arena = SENSORS_ARENA_INITIALIZER;
+	const sensors_prog **progs;
+	struct timespec start, end;
+	double old_result, new_result, old_time, new_time;
+	volatile double sink = 0;
+	int i, j, old_res, new_res, insns = 0, nodes = 0, errors = 0;
+	int iterations = 10000;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s config-file...\n", argv[0]);
+		return 1;
+	}
+
+	for (i = 1; i < argc; i++)
+		if (parse_file(argv[i]))
+			return 1;
+
+	for (i = 0; i < sensors_default_ctx.config_chips_count; i++) {
+		chip = &sensors_default_ctx.config_chips[i];
+		for (j = 0; j < chip->computes_count; j++) {
+			add_expr(chip->computes[j].from_proc);
+			add_expr(chip->computes[j].to_proc);
+		}
+	}
+	if (!exprs_count) {
+		fprintf(stderr, "No compute statements found\n");
+		return 1;
+	}
+
+	/* A chip without subfeatures, as expressions have no variables */
+	memset(&chip_features, 0, sizeof(chip_features));
+	snapshot.chip = &chip_features;
+	snapshot.sample = NULL;
+	progs = malloc(exprs_count * sizeof(*progs));
+	if (!progs)
+		sensors_fatal_error(__func__, "Out of memory");
+	for (i = 0; i < exprs_count; i++) {
+		progs[i] = sensors_compile_expr(&chip_features, exprs[i],
+						&arena);
+		insns += progs[i]->len;
+	}
+
+	for (i = 0; i < exprs_count; i++) {
+		old_result = new_result = 0;
+		old_res = old_eval_expr(exprs[i], TEST_VALUE, &old_result);
+		new_res = sensors_run_prog(&snapshot, progs[i],
+					   TEST_VALUE, &new_result);
+		if (old_res != new_res ||
+		    (!old_res && fabs(old_result - new_result) >
+				 1e-9 * fabs(old_result))) {
+			fprintf(stderr, "Expression %d: got %d (%g), expected "
+				"%d (%g)\n", i, new_res, new_result, old_res,
+				old_result);
+			errors++;
+		}
+	}
+	if (errors)
+		return 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < iterations; i++)
+		for (j = 0; j < exprs_count; j++)
+			if (!old_eval_expr(exprs[j], TEST_VALUE, &old_result))
+				sink += old_result;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	old_time = elapsed_ns(&start, &end) / iterations / exprs_count;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < iterations; i++)
+		for (j = 0; j < exprs_count; j++)
+			if (!sensors_run_prog(&snapshot, progs[j],
+					      TEST_VALUE, &new_result))
+				sink += new_result;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	new_time = elapsed_ns(&start, &end) / iterations / exprs_count;
+	(void)sink;
+
+	for (i = 0; i < exprs_count; i++)
+		nodes += count_nodes(exprs[i]);
+
+	printf("%d expressions, %.1f nodes, %.1f instructions on average\n",
+	       exprs_count, (double)nodes / exprs_count,
+	       (double)insns / exprs_count);
+	printf("tree walker: %8.1f ns/expression\n", old_time);
+	printf("bytecode:    %8.1f ns/expression\n", new_time);
+
+	free(progs);
+	free(exprs);
+	sensors_arena_free(&arena);
+	sensors_cleanup();
+
+	return 0;
+}
@@ -0,0 +1,93 @@
+/*
+    bench-init.c - Benchmark of sensors_init() with and without chips cache.
+    Copyright (C) 2026 The lm-sensors developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2 of the License.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "../sensors.h"
+#include "../error.h"
+#include "../cache.h"
+
+/* Average time of one sensors_init() call, in microseconds. The cache is
+   removed before each call if cold is set. */
+static double time_init(FILE *config, int iterations, int cold)
+{
+	struct timespec start, end;
+	double total = 0;
+	int i, err;
+
+	for (i = 0; i < iterations; i++) {
+		if (cold && unlink(SENSORS_CACHE_FILE) < 0 && errno != ENOENT) {
+			perror(SENSORS_CACHE_FILE);
+			exit(1);
+		}
+		if (config)
+			rewind(config);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		err = sensors_init(config);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if (err) {
+			fprintf(stderr, "sensors_init: %s\n",
+				sensors_strerror(err));
+			exit(1);
+		}
+		sensors_cleanup();
+
+		total += (end.tv_sec - start.tv_sec) * 1e6 +
+			 (end.tv_nsec - start.tv_nsec) / 1e3;
+	}
+	return total / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *config = NULL;
+	int iterations = 100;
+	double cold, warm;
+
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+	if (argc > 2 && !(config = fopen(argv[2], "r"))) {
+		perror(argv[2]);
+		return 1;
+	}
+	if (iterations <= 0) {
+		fprintf(stderr, "Usage: %s [iterations [config]]\n", argv[0]);
+		return 1;
+	}
+	if (access(RUNDIR, W_OK)) {
+		fprintf(stderr, "%s must exist and be writable: %s\n",
+			RUNDIR, strerror(errno));
+		return 1;
+	}
+
+	cold = time_init(config, iterations, 1);
+	warm = time_init(config, iterations, 0);
+	printf("sensors_init() without cache: %10.1f us\n", cold);
+	printf("sensors_init() with cache:    %10.1f us\n", warm);
+
+	if (config)
+		fclose(config);
+	return 0;
+}
@@ -0,0 +1,329 @@
+/*
+    test-hotplug.c - Test of the hotplug support of libsensors.
+    Copyright (C) 2026 The lm-sensors developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2 of the License.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+/*
+ * Build a sysfs tree with one virtual hwmon device in a temporary
+ * directory, then add and remove devices, feeding the matching uevents to
+ * sensors_process_uevents() through a socket pair.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "../sensors.h"
+#include "../error.h"
+#include "../data.h"
+#include "../access.h"
+#include "../sysfs.h"
+#include "../hotplug.h"
+
+static char root[] = "/tmp/test-hotplug.XXXXXX";
+
+/* The uevents are sent to fds[0], and received from fds[1]. If lost is
+   set, the next call reports that some were lost. */
+static int fds[2], lost;
+
+static void write_file(const char *path, const char *value)
+{
+	FILE *f;
+
+	if (!(f = fopen(path, "w"))) {
+		perror(path);
+		exit(1);
+	}
+	fputs(value, f);
+	fclose(f);
+}
+
+static void add_device(const char *hwmon, const char *name, const char *temp)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/class/hwmon/%s", root, hwmon);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/class/hwmon/%s/name", root, hwmon);
+	write_file(path, name);
+	snprintf(path, sizeof(path), "%s/class/hwmon/%s/temp1_input", root,
+		 hwmon);
+	write_file(path, temp);
+}
+
+static void remove_device(const char *hwmon)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/class/hwmon/%s/name", root, hwmon);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/class/hwmon/%s/temp1_input", root,
+		 hwmon);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/class/hwmon/%s", root, hwmon);
+	rmdir(path);
+}
+
+/* Send a uevent as the kernel formats them */
+static void send_uevent(const char *action, const char *hwmon,
+			const char *subsystem)
+{
+	char buf[512];
+	int len;
+
+	len = snprintf(buf, sizeof(buf),
+		       "%s@/devices/virtual/hwmon/%s%c"
+		       "ACTION=%s%cDEVPATH=/devices/virtual/hwmon/%s%c"
+		       "SUBSYSTEM=%s%cSEQNUM=1234", action, hwmon, 0,
+		       action, 0, hwmon, 0, subsystem, 0);
+	if (send(fds[0], buf, len + 1, 0) < 0) {
+		perror("send");
+		exit(1);
+	}
+}
+
+static ssize_t next_uevent(void *data, char *buf, size_t size)
+{
+	ssize_t len;
+
+	(void)data;
+	if (lost) {
+		lost = 0;
+		return -ENOBUFS;
+	}
+	len = recv(fds[1], buf, size, MSG_DONTWAIT);
+	if (len < 0)
+		return errno == EAGAIN ? 0 : -errno;
+	return len;
+}
+
+/* Apply the pending uevents, as sensors_hotplug_process() would */
+static int process_uevents(void)
+{
+	return sensors_process_uevents(&sensors_default_ctx, next_uevent,
+				       NULL);
+}
+
+static int count_chips(void)
+{
+	int nr = 0, count = 0;
+
+	while (sensors_get_detected_chips(NULL, &nr))
+		count++;
+	return count;
+}
+
+/* Return the name of the chip with the given prefix, or NULL */
+static const sensors_chip_name *get_name(const char *prefix)
+{
+	const sensors_chip_name *name;
+	int nr = 0;
+
+	while ((name = sensors_get_detected_chips(NULL, &nr)))
+		if (!strcmp(name->prefix, prefix))
+			return name;
+	return NULL;
+}
+
+/* Return the temperature of the chip with the given prefix, or -1 */
+static double read_temp(const char *prefix)
+{
+	const sensors_chip_name *name;
+	const sensors_feature *feature;
+	const sensors_subfeature *sf;
+	double value;
+	int nr = 0, fnr;
+
+	while ((name = sensors_get_detected_chips(NULL, &nr))) {
+		if (strcmp(name->prefix, prefix))
+			continue;
+		fnr = 0;
+		if (!(feature = sensors_get_features(name, &fnr)) ||
+		    !(sf = sensors_get_subfeature(name, feature,
+					SENSORS_SUBFEATURE_TEMP_INPUT)) ||
+		    sensors_get_value(name, sf->number, &value))
+			return -1;
+		return value;
+	}
+	return -1;
+}
+
+/* Return the handle of the temperature of the chip with the given prefix,
+   or NULL. The chip handle it comes from is stored to chip, for the caller
+   to free. */
+static const sensors_sf_handle *get_temp_handle(const char *prefix,
+					const sensors_chip_handle **chip)
+{
+	const sensors_chip_name *name;
+	const sensors_feature *feature;
+	const sensors_subfeature *sf;
+	int nr = 0, fnr = 0;
+
+	while ((name = sensors_get_detected_chips(NULL, &nr))) {
+		if (strcmp(name->prefix, prefix))
+			continue;
+		if (!(*chip = sensors_get_chip_handle(name)) ||
+		    !(feature = sensors_handle_get_features(*chip, &fnr)) ||
+		    !(sf = sensors_handle_get_subfeature(*chip, feature,
+					SENSORS_SUBFEATURE_TEMP_INPUT)))
+			return NULL;
+		return sensors_get_sf_handle(*chip, sf->number);
+	}
+	return NULL;
+}
+
+/* Return the temperature read through a handle, or -1 */
+static double read_temp_handle(const sensors_sf_handle *sf)
+{
+	double value;
+
+	if (!sf || sensors_handle_get_value(sf, &value))
+		return -1;
+	return value;
+}
+
+static int check(const char *what, int cond)
+{
+	printf("%-40s %s\n", what, cond ? "ok" : "FAILED");
+	return !cond;
+}
+
+int main(void)
+{
+	char path[PATH_MAX];
+	const sensors_chip_name *alpha_name;
+	const sensors_chip_handle *alpha_chip, *beta_chip;
+	const sensors_sf_handle *alpha, *beta;
+	int res, errors = 0;
+	unsigned int gen;
+	double value;
+
+	if (!mkdtemp(root)) {
+		perror(root);
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s/class", root);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/class/hwmon", root);
+	mkdir(path, 0755);
+	add_device("hwmon0", "alpha", "41000\n");
+
+	/* Discover the chips from our tree, as sensors_init() would */
+	snprintf(sensors_sysfs_mount, NAME_MAX, "%s", root);
+	if (sensors_read_sysfs_chips(&sensors_default_ctx))
+		return 1;
+	sensors_index_proc_chips(sensors_proc_chips(&sensors_default_ctx));
+	sensors_resolve_config(&sensors_default_ctx);
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+
+	errors += check("initial chips", count_chips() == 1 &&
+			read_temp("alpha") == 41.0);
+	alpha = get_temp_handle("alpha", &alpha_chip);
+	errors += check("initial handle", read_temp_handle(alpha) == 41.0);
+	gen = sensors_get_chips_generation();
+
+	errors += check("no event", process_uevents() == 0);
+
+	add_device("hwmon1", "beta", "52000\n");
+	send_uevent("add", "hwmon1", "hwmon");
+	res = process_uevents();
+	errors += check("add", res == 1 && count_chips() == 2 &&
+			read_temp("beta") == 52.0 &&
+			read_temp("alpha") == 41.0);
+	beta = get_temp_handle("beta", &beta_chip);
+	errors += check("handles after add", read_temp_handle(alpha) == 41.0 &&
+			read_temp_handle(beta) == 52.0);
+	errors += check("generation after add",
+			sensors_get_chips_generation() != gen);
+	gen = sensors_get_chips_generation();
+
+	send_uevent("add", "input3", "input");
+	send_uevent("change", "hwmon1", "hwmon");
+	errors += check("unrelated events",
+			process_uevents() == 0 &&
+			count_chips() == 2 &&
+			sensors_get_chips_generation() == gen);
+
+	alpha_name = get_name("alpha");
+	remove_device("hwmon0");
+	send_uevent("remove", "hwmon0", "hwmon");
+	res = process_uevents();
+	errors += check("remove", res == 1 && count_chips() == 1 &&
+			read_temp("alpha") == -1 &&
+			read_temp("beta") == 52.0);
+	errors += check("handles after remove",
+			read_temp_handle(alpha) == -1 &&
+			read_temp_handle(beta) == 52.0);
+	errors += check("generation after remove",
+			sensors_get_chips_generation() != gen);
+	/* Valid until the next sensors_hotplug_process() call */
+	errors += check("name after remove",
+			!strcmp(alpha_name->prefix, "alpha") &&
+			sensors_get_value(alpha_name, 0, &value) ==
+			-SENSORS_ERR_NO_ENTRY);
+
+	send_uevent("remove", "hwmon7", "hwmon");
+	errors += check("remove unknown device",
+			process_uevents() == 0 &&
+			count_chips() == 1);
+
+	add_device("hwmon0", "alpha", "43000\n");
+	send_uevent("add", "hwmon0", "hwmon");
+	res = process_uevents();
+	errors += check("add again", res == 1 && count_chips() == 2 &&
+			read_temp("alpha") == 43.0 &&
+			read_temp_handle(alpha) == -1 &&
+			read_temp_handle(beta) == 52.0);
+
+	/* Whatever the events received meanwhile say, all chips are read
+	   again */
+	remove_device("hwmon1");
+	add_device("hwmon2", "gamma", "63000\n");
+	send_uevent("add", "hwmon1", "hwmon");
+	lost = 1;
+	res = process_uevents();
+	errors += check("lost events", res > 0 && count_chips() == 2 &&
+			read_temp("alpha") == 43.0 &&
+			read_temp("beta") == -1 &&
+			read_temp("gamma") == 63.0 &&
+			read_temp_handle(beta) == -1);
+
+	close(fds[0]);
+	close(fds[1]);
+	sensors_free_chip_handle(alpha_chip);
+	sensors_free_chip_handle(beta_chip);
+	sensors_cleanup();
+	remove_device("hwmon0");
+	remove_device("hwmon2");
+	snprintf(path, sizeof(path), "%s/class/hwmon", root);
+	rmdir(path);
+	snprintf(path, sizeof(path), "%s/class", root);
+	rmdir(path);
+	rmdir(root);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,312 @@
+/*
+    test-watch.c - Test of the alarm notifications of libsensors.
+    Copyright (C) 2026 The lm-sensors developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2 of the License.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+/*
+ * Build a sysfs tree with two virtual hwmon devices in a temporary
+ * directory, and check that the changes of their alarms are reported.
+ * sysfs_notify() can't be reproduced with regular files, so once a chip
+ * is loaded, its alarm attributes are replaced with FIFOs: writing a
+ * value to one and closing it wakes up its readers, as sysfs_notify()
+ * does. Discovery only reads regular files, hence the late replacement.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "../sensors.h"
+#include "../data.h"
+#include "../access.h"
+#include "../sysfs.h"
+
+static char root[] = "/tmp/test-watch.XXXXXX";
+
+static const char *files[] = {
+	"hwmon0/name", "hwmon0/temp1_input", "hwmon0/temp1_alarm",
+	"hwmon0/temp1_max_alarm", "hwmon0/temp2_input",
+	"hwmon1/name", "hwmon1/in0_input", "hwmon1/in0_alarm",
+	NULL
+};
+
+static void attr_path(char *path, const char *attr)
+{
+	snprintf(path, PATH_MAX, "%s/class/hwmon/%s", root, attr);
+}
+
+static void write_file(const char *attr, const char *value)
+{
+	char path[PATH_MAX];
+	FILE *f;
+
+	attr_path(path, attr);
+	if (!(f = fopen(path, "w"))) {
+		perror(path);
+		exit(1);
+	}
+	fputs(value, f);
+	fclose(f);
+}
+
+/* Replace an attribute of a loaded chip with a FIFO */
+static void make_fifo(const char *attr)
+{
+	char path[PATH_MAX];
+
+	attr_path(path, attr);
+	if (unlink(path) < 0 || mkfifo(path, 0644) < 0) {
+		perror(path);
+		exit(1);
+	}
+}
+
+/* Change an alarm, as the driver would */
+static void notify(const char *attr)
+{
+	char path[PATH_MAX];
+	int fd;
+
+	/* Fails with ENXIO if nobody is watching */
+	attr_path(path, attr);
+	if ((fd = open(path, O_WRONLY | O_NONBLOCK)) < 0) {
+		if (errno == ENXIO)
+			return;
+		perror(path);
+		exit(1);
+	}
+	if (write(fd, "1\n", 2) != 2)
+		perror(path);
+	close(fd);
+}
+
+/* Load the features of the chip with the given prefix, and no other */
+static void load_chip(const char *prefix)
+{
+	char pattern[32];
+	sensors_chip_name match;
+	const sensors_chip_name *name;
+	int nr = 0, fnr = 0;
+
+	snprintf(pattern, sizeof(pattern), "%s-*", prefix);
+	if (sensors_parse_chip_name(pattern, &match) ||
+	    !(name = sensors_get_detected_chips(&match, &nr))) {
+		fprintf(stderr, "%s: Chip not found\n", prefix);
+		exit(1);
+	}
+	sensors_get_features(name, &fnr);
+	sensors_free_chip_name(&match);
+}
+
+static int fd_readable(int fd, int timeout)
+{
+	struct pollfd pfd = { fd, POLLIN, 0 };
+
+	return poll(&pfd, 1, timeout) == 1 && (pfd.revents & POLLIN);
+}
+
+/* Read the next change, and check that it is the expected one */
+static int next_alarm(sensors_watch *watch, const char *prefix,
+		      const char *attr)
+{
+	const sensors_chip_name *name;
+	const sensors_subfeature *sf;
+
+	if (sensors_read_watch(watch, 1000, &name, &sf) != 1)
+		return 0;
+	return !strcmp(name->prefix, prefix) && !strcmp(sf->name, attr);
+}
+
+/* Return the value of a subfeature of the chip with the given prefix, or
+   -1 */
+static double read_value(const char *prefix, const char *attr)
+{
+	const sensors_chip_name *name;
+	const sensors_feature *feature;
+	const sensors_subfeature *sf;
+	double value;
+	int nr = 0, fnr, sfnr;
+
+	while ((name = sensors_get_detected_chips(NULL, &nr))) {
+		if (strcmp(name->prefix, prefix))
+			continue;
+		for (fnr = 0; (feature = sensors_get_features(name, &fnr));)
+			for (sfnr = 0;
+			     (sf = sensors_get_all_subfeatures(name, feature,
+							       &sfnr));)
+				if (!strcmp(sf->name, attr))
+					return sensors_get_value(name,
+							sf->number, &value) ?
+					       -1 : value;
+	}
+	return -1;
+}
+
+static int no_alarm(sensors_watch *watch)
+{
+	const sensors_chip_name *name;
+	const sensors_subfeature *sf;
+
+	return sensors_read_watch(watch, 0, &name, &sf) == 0;
+}
+
+/* Return whether the chip with the given prefix was loaded, or -1 if it
+   isn't found */
+static int chip_loaded(const char *prefix)
+{
+	const sensors_chip_list *list;
+	int i;
+
+	list = sensors_proc_chips(&sensors_default_ctx);
+	for (i = 0; i < list->count; i++)
+		if (!strcmp(list->chip[i]->chip.prefix, prefix))
+			return list->chip[i]->loaded;
+	return -1;
+}
+
+static int check(const char *what, int cond)
+{
+	printf("%-40s %s\n", what, cond ? "ok" : "FAILED");
+	return !cond;
+}
+
+int main(void)
+{
+	char path[PATH_MAX];
+	sensors_chip_name beta, betas[2];
+	sensors_watch *watch;
+	const sensors_chip_name *name;
+	const sensors_subfeature *sf;
+	int i, seen, errors = 0;
+
+	if (!mkdtemp(root)) {
+		perror(root);
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s/class", root);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/class/hwmon", root);
+	mkdir(path, 0755);
+	attr_path(path, "hwmon0");
+	mkdir(path, 0755);
+	attr_path(path, "hwmon1");
+	mkdir(path, 0755);
+
+	write_file("hwmon0/name", "alpha\n");
+	write_file("hwmon0/temp1_input", "41000\n");
+	write_file("hwmon0/temp1_alarm", "0\n");
+	write_file("hwmon0/temp1_max_alarm", "0\n");
+	write_file("hwmon0/temp2_input", "42000\n");
+	write_file("hwmon1/name", "beta\n");
+	write_file("hwmon1/in0_input", "1200\n");
+	write_file("hwmon1/in0_alarm", "0\n");
+
+	/* Discover the chips from our tree, as sensors_init() would */
+	snprintf(sensors_sysfs_mount, NAME_MAX, "%s", root);
+	if (sensors_read_sysfs_chips(&sensors_default_ctx))
+		return 1;
+	sensors_index_proc_chips(sensors_proc_chips(&sensors_default_ctx));
+	sensors_resolve_config(&sensors_default_ctx);
+
+	/* Only the chips a watch is for are loaded */
+	load_chip("beta");
+	make_fifo("hwmon1/in0_alarm");
+	if (sensors_parse_chip_name("beta-*", &beta))
+		return 1;
+	errors += check("create watch for one chip",
+			sensors_create_watch(&beta, 1, &watch) == 0 &&
+			chip_loaded("alpha") == 0);
+	sensors_free_watch(watch);
+
+	load_chip("alpha");
+	make_fifo("hwmon0/temp1_alarm");
+	make_fifo("hwmon0/temp1_max_alarm");
+
+	errors += check("create watch",
+			sensors_create_watch(NULL, 0, &watch) == 0);
+	errors += check("no alarm", no_alarm(watch) &&
+			!fd_readable(sensors_get_watch_fd(watch), 0));
+
+	notify("hwmon0/temp1_alarm");
+	errors += check("fd readable",
+			fd_readable(sensors_get_watch_fd(watch), 1000));
+	errors += check("alarm", next_alarm(watch, "alpha", "temp1_alarm") &&
+			no_alarm(watch));
+
+	/* Values cached before an alarm aren't returned after it */
+	sensors_set_cache_time(60000);
+	errors += check("cached value", read_value("alpha", "temp1_input") == 41);
+	write_file("hwmon0/temp1_input", "43000\n");
+	notify("hwmon0/temp1_alarm");
+	errors += check("value after alarm",
+			next_alarm(watch, "alpha", "temp1_alarm") &&
+			read_value("alpha", "temp1_input") == 43);
+
+	notify("hwmon0/temp1_max_alarm");
+	notify("hwmon1/in0_alarm");
+	for (i = seen = 0; i < 2; i++) {
+		if (sensors_read_watch(watch, 1000, &name, &sf) != 1)
+			break;
+		if (!strcmp(sf->name, "temp1_max_alarm"))
+			seen |= 1;
+		else if (!strcmp(sf->name, "in0_alarm"))
+			seen |= 2;
+	}
+	errors += check("two alarms", seen == 3 && no_alarm(watch));
+
+	notify("hwmon0/temp1_alarm");
+	errors += check("same alarm again",
+			next_alarm(watch, "alpha", "temp1_alarm") &&
+			no_alarm(watch));
+	sensors_free_watch(watch);
+
+	/* Only watch the second chip, matched twice */
+	betas[0] = betas[1] = beta;
+	errors += check("create watch for one chip again",
+			sensors_create_watch(betas, 2, &watch) == 0);
+	sensors_free_chip_name(&beta);
+	notify("hwmon0/temp1_alarm");
+	notify("hwmon1/in0_alarm");
+	errors += check("alarm of that chip only",
+			next_alarm(watch, "beta", "in0_alarm") &&
+			no_alarm(watch));
+	sensors_free_watch(watch);
+
+	sensors_cleanup();
+	for (i = 0; files[i]; i++) {
+		attr_path(path, files[i]);
+		unlink(path);
+	}
+	attr_path(path, "hwmon0");
+	rmdir(path);
+	attr_path(path, "hwmon1");
+	rmdir(path);
+	snprintf(path, sizeof(path), "%s/class/hwmon", root);
+	rmdir(path);
+	snprintf(path, sizeof(path), "%s/class", root);
+	rmdir(path);
+	rmdir(root);
+
+	return errors ? 1 : 0;
+}
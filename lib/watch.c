@@ -0,0 +1,293 @@
+/*
+    watch.c - Part of libsensors, a Linux library for reading sensor data.
+    Copyright (C) 2026        The lm-sensors developers
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+    MA 02110-1301 USA.
+*/
+
+/*
+ * Alarm notifications
+ *
+ * Many hwmon drivers call sysfs_notify() on their alarm attributes when
+ * these change, which wakes up the processes polling the attribute for
+ * POLLPRI. A watch keeps the alarm attributes of the chips it was created
+ * for open, in an epoll set, so that applications can wait for alarms
+ * instead of reading them periodically.
+ */
+
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include "sensors.h"
+#include "data.h"
+#include "error.h"
+#include "general.h"
+#include "access.h"
+#include "init.h"
+#include "sysfs.h"
+
+#define WATCH_EVENTS	16
+
+/* The handle tells whether the chip was removed since. The file of such
+   an entry is closed by sensors_read_watch(), and fd set to -1. */
+struct sensors_watch_entry {
+	const sensors_sf_handle *sf;
+	int fd;
+};
+
+struct sensors_watch {
+	sensors_pins *pins;	/* those of the context */
+	int epoll_fd;
+	struct sensors_watch_entry *entry;
+	int count;
+	int max;
+	/* The handles of the chips watched, of which the watch holds a
+	   reference */
+	const sensors_chip_handle **chip;
+	int chip_count;
+	int chip_max;
+	/* Events returned by epoll_wait() but not by sensors_read_watch()
+	   yet */
+	struct epoll_event event[WATCH_EVENTS];
+	int event_count;
+	int event_next;
+};
+
+static int sensors_is_alarm(const sensors_subfeature *subfeature)
+{
+	size_t len = strlen(subfeature->name);
+
+	return len > 6 && !strcmp(subfeature->name + len - 6, "_alarm");
+}
+
+/* Read an attribute, which acknowledges its changes */
+static void sensors_watch_drain(int fd)
+{
+	char buf[32];
+
+	lseek(fd, 0, SEEK_SET);
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+}
+
+static int sensors_watch_add(sensors_watch *watch,
+			     const sensors_chip_name *name,
+			     const sensors_sf_handle *sf)
+{
+	const sensors_subfeature *subfeature = sf->subfeature;
+	struct sensors_watch_entry entry;
+	struct epoll_event event;
+	char path[PATH_MAX];
+
+	if (snprintf(path, sizeof(path), "%s/%s", name->path,
+		     subfeature->name) >= (int)sizeof(path))
+		return -SENSORS_ERR_KERNEL;
+	/* Opening a FIFO must not block, the test suite uses them instead
+	   of sysfs attributes */
+	entry.fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (entry.fd < 0)
+		return -SENSORS_ERR_KERNEL;
+	/* sysfs reports a change until the attribute is first read */
+	sensors_watch_drain(entry.fd);
+
+	/* Edge-triggered, as sysfs attributes are always readable; each
+	   sysfs_notify() call is then reported once */
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLPRI | EPOLLET;
+	event.data.u32 = watch->count;
+	if (epoll_ctl(watch->epoll_fd, EPOLL_CTL_ADD, entry.fd, &event) < 0) {
+		close(entry.fd);
+		return -SENSORS_ERR_KERNEL;
+	}
+
+	entry.sf = sf;
+	sensors_add_array_el(&entry, &watch->entry, &watch->count,
+			     &watch->max, sizeof(entry));
+	return 0;
+}
+
+/* Add the readable alarm subfeatures of a chip to a watch */
+static int sensors_watch_add_chip(sensors_ctx *ctx, sensors_watch *watch,
+				  const sensors_chip_name *name)
+{
+	const sensors_chip_handle *chip;
+	const sensors_feature *feature;
+	const sensors_subfeature *subfeature;
+	int fnr, sfnr, err;
+
+	if (!(chip = sensors_ctx_get_chip_handle(ctx, name)))
+		return 0;
+	sensors_add_array_el(&chip, &watch->chip, &watch->chip_count,
+			     &watch->chip_max, sizeof(chip));
+
+	for (fnr = 0; (feature = sensors_ctx_get_features(ctx, name, &fnr));)
+		for (sfnr = 0;
+		     (subfeature = sensors_ctx_get_all_subfeatures(ctx, name,
+							feature, &sfnr));) {
+			if (!sensors_is_alarm(subfeature) ||
+			    !(subfeature->flags & SENSORS_MODE_R))
+				continue;
+			if ((err = sensors_watch_add(watch, name,
+					sensors_get_sf_handle(chip,
+							subfeature->number))))
+				return err;
+		}
+	return 0;
+}
+
+static int sensors_create_watch_pinned(sensors_ctx *ctx,
+				       const sensors_chip_name *match,
+				       int match_count, sensors_watch **watch)
+{
+	const sensors_chip_name *name, *m;
+	sensors_watch *w;
+	int nr, i, j, err;
+
+	w = calloc(1, sizeof(sensors_watch));
+	if (!w)
+		sensors_fatal_error(__func__, "Out of memory");
+	w->pins = ctx->pins;
+	w->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (w->epoll_fd < 0) {
+		free(w);
+		return -SENSORS_ERR_KERNEL;
+	}
+
+	/* Look the chips up by name, so that only those which match are
+	   loaded */
+	for (i = 0; i < (match_count ? match_count : 1); i++) {
+		m = match_count ? &match[i] : NULL;
+		for (nr = 0;
+		     (name = sensors_ctx_get_detected_chips(ctx, m, &nr));) {
+			/* Chips which match an earlier name are watched
+			   already */
+			for (j = 0; j < i; j++)
+				if (sensors_match_chip(name, &match[j]))
+					break;
+			if (j < i)
+				continue;
+
+			if ((err = sensors_watch_add_chip(ctx, w, name))) {
+				sensors_free_watch(w);
+				return err;
+			}
+		}
+	}
+
+	*watch = w;
+	return 0;
+}
+
+int sensors_ctx_create_watch(sensors_ctx *ctx,
+			     const sensors_chip_name *match, int match_count,
+			     sensors_watch **watch)
+{
+	int res, pin;
+
+	pin = sensors_pin(ctx->pins);
+	res = sensors_create_watch_pinned(ctx, match, match_count, watch);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_create_watch(const sensors_chip_name *match, int match_count,
+			 sensors_watch **watch)
+{
+	sensors_ctx *ctx;
+	int res, pin;
+
+	ctx = sensors_pin_default_ctx(&pin);
+	res = sensors_create_watch_pinned(ctx, match, match_count, watch);
+	sensors_unpin(ctx->pins, pin);
+	return res;
+}
+
+int sensors_get_watch_fd(const sensors_watch *watch)
+{
+	return watch->epoll_fd;
+}
+
+int sensors_read_watch(sensors_watch *watch, int timeout,
+		       const sensors_chip_name **name,
+		       const sensors_subfeature **subfeature)
+{
+	struct sensors_watch_entry *entry;
+	const sensors_chip_features *chip;
+	int n, pin;
+
+	for (;;) {
+		if (watch->event_next == watch->event_count) {
+			n = epoll_wait(watch->epoll_fd, watch->event,
+				       WATCH_EVENTS, timeout);
+			if (n < 0 && errno != EINTR)
+				return -SENSORS_ERR_KERNEL;
+			if (n <= 0)	/* timeout or signal */
+				return 0;
+			watch->event_count = n;
+			watch->event_next = 0;
+		}
+
+		/* Not while waiting, sensors_reload() would wait for us */
+		pin = sensors_pin(watch->pins);
+		n = watch->event[watch->event_next++].data.u32;
+		entry = &watch->entry[n];
+		if (entry->fd < 0) {	/* already closed, event was pending */
+			sensors_unpin(watch->pins, pin);
+			continue;
+		}
+		if ((chip = sensors_handle_chip(entry->sf->chip)))
+			break;
+
+		/* The chip was removed, stop watching it */
+		epoll_ctl(watch->epoll_fd, EPOLL_CTL_DEL, entry->fd, NULL);
+		close(entry->fd);
+		entry->fd = -1;
+		sensors_unpin(watch->pins, pin);
+	}
+
+	/* Read the attribute again, as sysfs expects before it reports
+	   the next change */
+	sensors_watch_drain(entry->fd);
+
+	/* The values of the chip cached so far may predate the change, and
+	   the driver may have updated other attributes along with it */
+	sensors_flush_sysfs_values(chip);
+
+	*name = &chip->chip;
+	*subfeature = entry->sf->subfeature;
+	sensors_unpin(watch->pins, pin);
+	return 1;
+}
+
+void sensors_free_watch(sensors_watch *watch)
+{
+	int i;
+
+	for (i = 0; i < watch->count; i++)
+		if (watch->entry[i].fd >= 0)
+			close(watch->entry[i].fd);
+	close(watch->epoll_fd);
+	free(watch->entry);
+	for (i = 0; i < watch->chip_count; i++)
+		sensors_free_chip_handle(watch->chip[i]);
+	free(watch->chip);
+	free(watch);
+}
@@ -42,10 +42,9 @@ static int loadConfig(const char *cfgPath, int reload)
  	if (!cfgPath) {
  		if (reload) {
 			sensorLog(LOG_INFO, "configuration reloading");
-			sensors_cleanup();
-		}
-
- 		ret = sensors_init(NULL);
+			ret = sensors_reload(NULL);
+		} else
+			ret = sensors_init(NULL);
  		if (ret) {
  			sensorLog(LOG_ERR, "Error loading default"
  				  " configuration file: %s",
@@ -64,9 +63,9 @@ static int loadConfig(const char *cfgPath, int reload)
 
 	if (reload) {
 		sensorLog(LOG_INFO, "configuration reloading");
-		sensors_cleanup();
-	}
- 	ret = sensors_init(fp);
+		ret = sensors_reload(fp);
+	} else
+		ret = sensors_init(fp);
  	if (ret) {
  		sensorLog(LOG_ERR, "Error loading sensors configuration file"
 			  " %s: %s", cfgPath, sensors_strerror(ret));
@@ -90,10 +89,15 @@ int loadLib(const char *cfgPath)
 int reloadLib(const char *cfgPath)
 {
 	int ret;
-	freeKnownChips();
+	/* On failure, keep going with the current configuration. Otherwise
+	   the chip names of the previous one, and the labels they came with,
+	   are freed by the next reload: switch to the new chip names now.
+	   Labels are looked up again from them on each pass, never kept. */
 	ret = loadConfig(cfgPath, 1);
-	if (!ret)
+	if (!ret) {
+		freeKnownChips();
 		ret = initKnownChips();
+	}
 	return ret;
 }
 
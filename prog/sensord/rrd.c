@@ -147,13 +147,14 @@ static int _applyToFeatures(FeatureFN fn, void *data,
 	const FeatureDescriptor *features = desc->features;
 	const FeatureDescriptor *feature;
 	const char *rawLabel;
-	char *label;
+	const char *label;
 
 	for (i = 0; labelOffset + i < MAX_RRD_SENSORS && features[i].format; ++i) {
 		feature = features + i;
 		rawLabel = feature->feature->name;
 
-		label = sensors_get_label(chip, feature->feature);
+		/* Only valid until the next reload, see reloadLib() */
+		label = sensors_get_label_ref(chip, feature->feature);
 		if (!label) {
 			sensorLog(LOG_ERR, "Error getting sensor label: %s/%s",
 				  chip->prefix, rawLabel);
@@ -162,7 +163,6 @@ static int _applyToFeatures(FeatureFN fn, void *data,
 
 		rrdCheckLabel(rawLabel, labelOffset + i);
 		fn(data, rrdLabels[labelOffset + i], label, feature);
-		free(label);
 	}
 	return i;
 }
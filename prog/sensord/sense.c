@@ -85,7 +85,7 @@ static int get_flag(const sensors_chip_name *chip, int num)
 static int do_features(const sensors_chip_name *chip,
 		       const FeatureDescriptor *feature, int action)
 {
-	char *label;
+	const char *label;
 	const char *formatted;
 	int i, alrm, beep, ret;
 	double val[MAX_DATA];
@@ -132,10 +132,8 @@ static int do_features(const sensors_chip_name *chip,
 		return -1;
 	}
 
-	/* FIXME: It would be more efficient to store the label at
-	 * initialization time.
-	 */
-	label = sensors_get_label(chip, feature->feature);
+	/* Only valid until the next reload, see reloadLib() */
+	label = sensors_get_label_ref(chip, feature->feature);
 	if (!label) {
 		sensorLog(LOG_ERR, "Error getting sensor label: %s/%s",
 			  chip->prefix, feature->feature->name);
@@ -148,8 +146,6 @@ static int do_features(const sensors_chip_name *chip,
 		sensorLog(LOG_ALERT, "Sensor alarm: Chip %s: %s: %s",
 			  chipName(chip), label, formatted);
 
-	free(label);
-
 	return 0;
 }
 
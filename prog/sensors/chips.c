@@ -37,12 +37,12 @@ void print_chip_raw(const sensors_chip_name *name)
 	int a, b, err;
 	const sensors_feature *feature;
 	const sensors_subfeature *sub;
-	char *label;
+	const char *label;
 	double val;
 
 	a = 0;
 	while ((feature = sensors_get_features(name, &a))) {
-		if (!(label = sensors_get_label(name, feature))) {
+		if (!(label = sensors_get_label_ref(name, feature))) {
 			fprintf(stderr, "ERROR: Can't get label of feature "
 				"%s!\n", feature->name);
 			continue;
@@ -63,7 +63,6 @@ void print_chip_raw(const sensors_chip_name *name)
 			} else
 				printf("(%s)\n", label);
 		}
-		free(label);
 	}
 }
 
@@ -72,13 +71,13 @@ void print_chip_json(const sensors_chip_name *name)
 	int a, b, cnt, subCnt, err;
 	const sensors_feature *feature;
 	const sensors_subfeature *sub;
-	char *label;
+	const char *label;
 	double val;
 
 	a = 0;
 	cnt = 0;
 	while ((feature = sensors_get_features(name, &a))) {
-		if (!(label = sensors_get_label(name, feature))) {
+		if (!(label = sensors_get_label_ref(name, feature))) {
 			fprintf(stderr, "ERROR: Can't get label of feature "
 				"%s!\n", feature->name);
 			continue;
@@ -108,7 +107,6 @@ void print_chip_json(const sensors_chip_name *name)
 			}
 			subCnt++;
 		}
-		free(label);
 		printf("\n      }");
 		cnt++;
 	}
@@ -162,15 +160,14 @@ static int get_label_size(const sensors_chip_name *name)
 {
 	int i;
 	const sensors_feature *iter;
-	char *label;
+	const char *label;
 	unsigned int max_size = 11;	/* 11 as minimum label width */
 
 	i = 0;
 	while ((iter = sensors_get_features(name, &i))) {
-		if ((label = sensors_get_label(name, iter)) &&
+		if ((label = sensors_get_label_ref(name, iter)) &&
 		    strlen(label) > max_size)
 			max_size = strlen(label);
-		free(label);
 	}
 
 	/* One more for the colon, and one more to guarantee at least one
@@ -345,16 +342,15 @@ static void print_chip_temp(const sensors_chip_name *name,
 	int sensor_count, alarm_count;
 	const sensors_subfeature *sf;
 	double val;
-	char *label;
+	const char *label;
 	int i;
 
-	if (!(label = sensors_get_label(name, feature))) {
+	if (!(label = sensors_get_label_ref(name, feature))) {
 		fprintf(stderr, "ERROR: Can't get label of feature %s!\n",
 			feature->name);
 		return;
 	}
 	print_label(label, label_size);
-	free(label);
 
 	sf = sensors_get_subfeature(name, feature,
 				    SENSORS_SUBFEATURE_TEMP_FAULT);
@@ -430,19 +426,18 @@ static void print_chip_in(const sensors_chip_name *name,
 			  int label_size)
 {
 	const sensors_subfeature *sf;
-	char *label;
+	const char *label;
 	struct sensor_subfeature_data sensors[NUM_IN_SENSORS];
 	struct sensor_subfeature_data alarms[NUM_IN_ALARMS];
 	int sensor_count, alarm_count;
 	double val;
 
-	if (!(label = sensors_get_label(name, feature))) {
+	if (!(label = sensors_get_label_ref(name, feature))) {
 		fprintf(stderr, "ERROR: Can't get label of feature %s!\n",
 			feature->name);
 		return;
 	}
 	print_label(label, label_size);
-	free(label);
 
 	sf = sensors_get_subfeature(name, feature,
 				    SENSORS_SUBFEATURE_IN_INPUT);
@@ -467,15 +462,14 @@ static void print_chip_fan(const sensors_chip_name *name,
 {
 	const sensors_subfeature *sf, *sfmin, *sfmax, *sfdiv;
 	double val;
-	char *label;
+	const char *label;
 
-	if (!(label = sensors_get_label(name, feature))) {
+	if (!(label = sensors_get_label_ref(name, feature))) {
 		fprintf(stderr, "ERROR: Can't get label of feature %s!\n",
 			feature->name);
 		return;
 	}
 	print_label(label, label_size);
-	free(label);
 
 	sf = sensors_get_subfeature(name, feature,
 				    SENSORS_SUBFEATURE_FAN_FAULT);
@@ -608,17 +602,16 @@ static void print_chip_power(const sensors_chip_name *name,
 	struct sensor_subfeature_data sensors[NUM_POWER_SENSORS];
 	struct sensor_subfeature_data alarms[NUM_POWER_ALARMS];
 	int sensor_count, alarm_count;
-	char *label;
+	const char *label;
 	const char *unit;
 	int i;
 
-	if (!(label = sensors_get_label(name, feature))) {
+	if (!(label = sensors_get_label_ref(name, feature))) {
 		fprintf(stderr, "ERROR: Can't get label of feature %s!\n",
 			feature->name);
 		return;
 	}
 	print_label(label, label_size);
-	free(label);
 
 	sensor_count = alarm_count = 0;
 
@@ -676,16 +669,15 @@ static void print_chip_energy(const sensors_chip_name *name,
 {
 	double val;
 	const sensors_subfeature *sf;
-	char *label;
+	const char *label;
 	const char *unit;
 
-	if (!(label = sensors_get_label(name, feature))) {
+	if (!(label = sensors_get_label_ref(name, feature))) {
 		fprintf(stderr, "ERROR: Can't get label of feature %s!\n",
 			feature->name);
 		return;
 	}
 	print_label(label, label_size);
-	free(label);
 
 	sf = sensors_get_subfeature(name, feature,
 				    SENSORS_SUBFEATURE_ENERGY_INPUT);
@@ -702,7 +694,7 @@ static void print_chip_vid(const sensors_chip_name *name,
 			   const sensors_feature *feature,
 			   int label_size)
 {
-	char *label;
+	const char *label;
 	const sensors_subfeature *subfeature;
 	double vid;
 
@@ -711,19 +703,18 @@ static void print_chip_vid(const sensors_chip_name *name,
 	if (!subfeature)
 		return;
 
-	if ((label = sensors_get_label(name, feature))
+	if ((label = sensors_get_label_ref(name, feature))
 	 && !sensors_get_value(name, subfeature->number, &vid)) {
 		print_label(label, label_size);
 		printf("%+6.3f V\n", vid);
 	}
-	free(label);
 }
 
 static void print_chip_humidity(const sensors_chip_name *name,
 				const sensors_feature *feature,
 				int label_size)
 {
-	char *label;
+	const char *label;
 	const sensors_subfeature *subfeature;
 	double humidity;
 
@@ -732,19 +723,18 @@ static void print_chip_humidity(const sensors_chip_name *name,
 	if (!subfeature)
 		return;
 
-	if ((label = sensors_get_label(name, feature))
+	if ((label = sensors_get_label_ref(name, feature))
 	 && !sensors_get_value(name, subfeature->number, &humidity)) {
 		print_label(label, label_size);
 		printf("%6.1f %%RH\n", humidity);
 	}
-	free(label);
 }
 
 static void print_chip_beep_enable(const sensors_chip_name *name,
 				   const sensors_feature *feature,
 				   int label_size)
 {
-	char *label;
+	const char *label;
 	const sensors_subfeature *subfeature;
 	double beep_enable;
 
@@ -753,12 +743,11 @@ static void print_chip_beep_enable(const sensors_chip_name *name,
 	if (!subfeature)
 		return;
 
-	if ((label = sensors_get_label(name, feature))
+	if ((label = sensors_get_label_ref(name, feature))
 	 && !sensors_get_value(name, subfeature->number, &beep_enable)) {
 		print_label(label, label_size);
 		printf("%s\n", beep_enable ? "enabled" : "disabled");
 	}
-	free(label);
 }
 
 static const struct sensor_subfeature_list current_sensors[] = {
@@ -786,18 +775,17 @@ static void print_chip_curr(const sensors_chip_name *name,
 {
 	const sensors_subfeature *sf;
 	double val;
-	char *label;
+	const char *label;
 	struct sensor_subfeature_data sensors[NUM_CURR_SENSORS];
 	struct sensor_subfeature_data alarms[NUM_CURR_ALARMS];
 	int sensor_count, alarm_count;
 
-	if (!(label = sensors_get_label(name, feature))) {
+	if (!(label = sensors_get_label_ref(name, feature))) {
 		fprintf(stderr, "ERROR: Can't get label of feature %s!\n",
 			feature->name);
 		return;
 	}
 	print_label(label, label_size);
-	free(label);
 
 	sf = sensors_get_subfeature(name, feature,
 				    SENSORS_SUBFEATURE_CURR_INPUT);
@@ -820,7 +808,7 @@ static void print_chip_intrusion(const sensors_chip_name *name,
 				 const sensors_feature *feature,
 				 int label_size)
 {
-	char *label;
+	const char *label;
 	const sensors_subfeature *subfeature;
 	double alarm;
 
@@ -829,12 +817,11 @@ static void print_chip_intrusion(const sensors_chip_name *name,
 	if (!subfeature)
 		return;
 
-	if ((label = sensors_get_label(name, feature))
+	if ((label = sensors_get_label_ref(name, feature))
 	 && !sensors_get_value(name, subfeature->number, &alarm)) {
 		print_label(label, label_size);
 		printf("%s\n", alarm ? "ALARM" : "OK");
 	}
-	free(label);
 }
 
 void print_chip(const sensors_chip_name *name)
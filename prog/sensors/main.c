@@ -82,8 +82,11 @@ static void print_version(void)
 	       libsensors_version);
 }
 
-/* Return 0 on success, and an exit error code otherwise */
-static int read_config_file(const char *config_file_name)
+/* Only the chips which match one of the match_count chip names match[]
+   are detected, all of them if match_count is 0. Return 0 on success, and
+   an exit error code otherwise */
+static int read_config_file(const char *config_file_name,
+			    const sensors_chip_name *match, int match_count)
 {
 	FILE *config_file;
 	int err;
@@ -104,7 +107,7 @@ static int read_config_file(const char *config_file_name)
 		config_file = NULL;
 	}
 
-	err = sensors_init(config_file);
+	err = sensors_init_ex(config_file, 0, match, match_count);
 	if (err) {
 		fprintf(stderr, "sensors_init: %s\n", sensors_strerror(err));
 		if (config_file)
@@ -270,8 +273,9 @@ static void print_bus_list(void)
 
 int main(int argc, char *argv[])
 {
-	int c, i, err, do_bus_list;
+	int c, i, err, do_bus_list, chips_count = 0;
 	const char *config_file_name = NULL;
+	sensors_chip_name *chips = NULL;
 
 	struct option long_opts[] =  {
 		{ "help", no_argument, NULL, 'h' },
@@ -334,7 +338,27 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	err = read_config_file(config_file_name);
+	/* Parse the chip names first, so that only those chips are detected */
+	if (!do_bus_list && optind < argc) {
+		chips = malloc((argc - optind) * sizeof(sensors_chip_name));
+		if (!chips) {
+			perror("malloc");
+			exit(1);
+		}
+		for (i = optind; i < argc; i++) {
+			if (sensors_parse_chip_name(argv[i],
+						    &chips[chips_count])) {
+				fprintf(stderr,
+					"Parse error in chip name `%s'\n",
+					argv[i]);
+				print_short_help();
+				exit(1);
+			}
+			chips_count++;
+		}
+	}
+
+	err = read_config_file(config_file_name, chips, chips_count);
 	if (err)
 		exit(err);
 
@@ -353,20 +377,9 @@ int main(int argc, char *argv[])
 		}
 	} else {
 		int cnt = 0;
-		sensors_chip_name chip;
 
-		for (i = optind; i < argc; i++) {
-			if (sensors_parse_chip_name(argv[i], &chip)) {
-				fprintf(stderr,
-					"Parse error in chip name `%s'\n",
-					argv[i]);
-				print_short_help();
-				err = 1;
-				goto exit;
-			}
-			cnt += do_the_real_work(&chip, &err);
-			sensors_free_chip_name(&chip);
-		}
+		for (i = 0; i < chips_count; i++)
+			cnt += do_the_real_work(&chips[i], &err);
 
 		if (!cnt) {
 			fprintf(stderr, "Specified sensor(s) not found!\n");
@@ -374,7 +387,9 @@ int main(int argc, char *argv[])
 		}
 	}
 
-exit:
+	for (i = 0; i < chips_count; i++)
+		sensors_free_chip_name(&chips[i]);
+	free(chips);
 	sensors_cleanup();
 	exit(err);
 }